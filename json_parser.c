@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <stddef.h>
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,6 +9,23 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+#ifdef JSON_STATS
+#include <malloc.h>
+#endif
+#ifdef JSON_BENCH
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define JSON_SIMD_X86           1
+#include <immintrin.h>
+#endif
 
 
 
@@ -39,8 +57,6 @@
 #define VC_ASM      1
 #endif
 
-typedef void (*vector_foreach_t)(void *);
-
 #ifdef ETHERNET_MODE
 // Структура описания ВК регулярного сообщения
 typedef struct
@@ -157,45 +173,682 @@ enum json_value_type {
     TYPE_OBJECT, // Is a vector with pairwise entries, key, value
     TYPE_ARRAY, // Is a vector, all entries are plain
     TYPE_STRING,
-    TYPE_KEY
+    TYPE_KEY,
+    TYPE_INTEGER // Number without fraction and exponent that fits into int64_t
 };
 
+// Флаги узла
+#define JSON_FLAG_BORROWED      0x01    // память узла ему не принадлежит (входной буфер или арена)
+#define JSON_FLAG_INDEXED       0x02    // за парами объекта размещена заполненная хеш-таблица ключей
+
+// Минимальное число пар объекта, для которого резервируется хеш-таблица ключей
+#define JSON_OBJECT_INDEX_MIN_PAIRS     32
+
+// Число элементов структурного индекса, просматриваемых для подсчета элементов контейнера
+// при его открытии (больший контейнер растет удвоением)
+#define JSON_PRESCAN_LIMIT              512
+
 typedef struct {
     int type;
+    int flags;
     union {
         int boolean;
         double number;
-        char* string;
+        int64_t integer;
+        struct {
+            char* data;     // начало строки, при разборе на месте не завершается нулем
+            size_t length;  // длина строки в байтах
+            uint32_t hash;  // хеш строки (вычисляется при разборе для ключей объектов)
+        } string;
         char* key;
         vector array;
         vector object;
     } value;
 } json_value;
 
+// Выравнивание выделений из арены
+#define JSON_ARENA_ALIGN        8
+// Минимальный размер блока арены
+#define JSON_ARENA_MIN_BLOCK    65536
+
+// Блок арены, данные следуют сразу за заголовком
+typedef struct json_arena_block {
+    struct json_arena_block *next;  // предыдущий (заполненный) блок
+    size_t size;                    // размер области данных
+    size_t used;                    // занято байт
+} json_arena_block;
+
+// Арена для линейного выделения памяти под дерево разбора
+typedef struct {
+    json_arena_block *head; // текущий блок
+    size_t block_size;      // минимальный размер следующего блока
+} json_arena;
+
+// Распределитель памяти для узлов, векторов и строк дерева разбора, а также для структурного индекса
+// и таблицы разбиения. alloc и realloc обязательны, free == NULL означает, что память освобождает
+// владелец распределителя целиком (как у арены): узлы помечаются JSON_FLAG_BORROWED и
+// json_free_value_allocator их не обходит, а временные буферы разбора берутся из кучи.
+// Буферы json_scratch всегда выделяются из кучи
+typedef struct {
+    void *(*alloc) (void *context, size_t size);
+    void *(*realloc) (void *context, void *ptr, size_t old_size, size_t new_size);
+    void (*free) (void *context, void *ptr);
+    void *context;
+} json_allocator;
+
+// Режимы разбора
+#define JSON_PARSE_IN_SITU      0x01    // строки ссылаются на входной буфер, экранирование раскрывается на месте
+
+// Параллельный разбор: наибольший массив верхних уровней делится на части по границам элементов
+#define JSON_SPLIT_MAX_DEPTH        4       // глубина, до которой ищется массив (корень - 1)
+#define JSON_SPLIT_MIN_ELEMENTS     256     // минимальное число элементов на один поток
+#define JSON_SPLIT_MAX_THREADS      256
+
+// Разбиение массива для параллельного разбора
+typedef struct {
+    size_t open;            // элемент структурного индекса с '['
+    size_t close;           // элемент структурного индекса с ']'
+    size_t *starts;         // элементы индекса, с которых начинаются элементы массива
+    size_t count;           // число элементов массива
+    int threads;            // число потоков разбора
+} json_split;
+
+// Буферы, повторно используемые между разборами нескольких документов (выделяются из кучи,
+// освобождаются json_scratch_free)
+typedef struct {
+    uint32_t *structurals;      // память структурного индекса
+    size_t capacity;            // число элементов
+} json_scratch;
+
+// Обработчики событий потокового разбора (без построения дерева). Каждый обработчик возвращает
+// 1 для продолжения разбора и 0 для его прерывания, NULL - событие пропускается. Строки и ключи
+// передаются без завершающего нуля и указывают во входной буфер
+typedef struct {
+    int (*on_null) (void *context);
+    int (*on_bool) (void *context, int value);
+    int (*on_integer) (void *context, int64_t value);
+    int (*on_number) (void *context, double value);
+    int (*on_string) (void *context, const char *data, size_t length);
+    int (*on_key) (void *context, const char *data, size_t length, uint32_t hash);
+    int (*on_object_begin) (void *context);
+    int (*on_object_end) (void *context);
+    int (*on_array_begin) (void *context);
+    int (*on_array_end) (void *context);
+} json_sax_handler;
+
+// Состояние разбора
+typedef struct {
+    const char *cursor;         // текущая позиция во входных данных
+    int flags;                  // режимы разбора JSON_PARSE_*
+    const json_allocator *allocator;    // распределитель для узлов и строк, NULL - выделение из кучи
+    json_arena *arena;          // арена, из которой выделяет allocator (потоки параллельного разбора
+                                // получают собственные арены), иначе NULL
+    const char *base;           // начало входных данных
+    uint32_t *structurals;      // структурный индекс (смещения значимых символов), NULL - посимвольный разбор
+    size_t structural_pos;      // следующий необработанный элемент индекса
+    size_t structural_count;    // число элементов индекса без завершающих
+    json_split *split;          // массив для параллельного разбора, NULL - разбор в одном потоке
+    json_scratch *scratch;      // буферы для повторного использования, NULL - выделяются на каждый разбор
+    const json_sax_handler *sax;    // обработчики событий потокового разбора
+    void *sax_context;              // контекст обработчиков
+} json_parser;
+
+// Результат json_stream_feed и json_stream_finish
+#define JSON_STREAM_ERROR       -1  // ошибка разбора либо разбор прерван обработчиком
+#define JSON_STREAM_NEED_MORE   0   // корневое значение не завершено, нужны следующие данные
+#define JSON_STREAM_COMPLETE    1   // корневое значение разобрано
+
+// Состояния потокового разбора по частям
+#define JSON_STREAM_VALUE           0   // ожидается значение
+#define JSON_STREAM_VALUE_OR_END    1   // после '[': значение или ']'
+#define JSON_STREAM_KEY_OR_END      2   // после '{' или ',' в объекте: ключ или '}'
+#define JSON_STREAM_COLON           3   // после ключа
+#define JSON_STREAM_COMMA_OR_END    4   // после значения в контейнере
+#define JSON_STREAM_STRING          5   // внутри строки или ключа
+#define JSON_STREAM_NUMBER          6   // внутри числа
+#define JSON_STREAM_LITERAL         7   // внутри true, false или null
+#define JSON_STREAM_DONE            8   // корневое значение разобрано, остаток входных данных не учитывается
+#define JSON_STREAM_FAILED          9   // ошибка
+
+// Состояние разбора по частям: входные данные подаются фрагментами произвольной длины,
+// незавершенная лексема накапливается в token между вызовами. События те же, что у json_parse_sax,
+// но строки и ключи указывают в token и действительны только во время вызова обработчика
+typedef struct {
+    const json_sax_handler *handler;
+    void *context;
+    int state;              // JSON_STREAM_*
+    int is_key;             // разбираемая строка - ключ объекта
+    int escape;             // предыдущий символ строки - неэкранированная '\\'
+    int escaped;            // в строке есть escape-последовательности
+    char *stack;            // открытые контейнеры: '{' или '['
+    size_t depth;
+    size_t stack_capacity;
+    char *token;            // незавершенная лексема
+    size_t token_length;
+    size_t token_capacity;
+} json_stream;
+
+// Элемент ленты документа. Значения записываются в порядке обхода в глубину, контейнер
+// предшествует своим элементам, в объекте за каждым ключом (TYPE_KEY) следует значение.
+// За парами объекта из JSON_OBJECT_INDEX_MIN_PAIRS и более пар размещается хеш-таблица
+// ключей (смещения ключей от объекта), которая входит в skip объекта
+typedef struct {
+    uint32_t type;              // TYPE_*
+    uint32_t length;            // строка и ключ: длина; массив: число элементов; объект: число пар
+    union {
+        int boolean;
+        double number;
+        int64_t integer;
+        struct {
+            uint32_t offset;    // смещение в буфере строк (строка завершается нулем)
+            uint32_t hash;      // хеш ключа
+        } string;
+        uint64_t skip;          // контейнер: число занимаемых элементов ленты вместе с ним самим
+    } value;
+} json_tape_token;
+
+// Документ в виде ленты: элементы фиксированного размера в одном массиве и строки в одном буфере.
+// Буферы сохраняются между разборами
+typedef struct {
+    json_tape_token *tokens;
+    size_t count;
+    size_t capacity;
+    char *strings;              // строки и ключи с завершающими нулями
+    size_t strings_size;
+    size_t strings_capacity;
+    size_t *stack;              // номера открытых контейнеров (во время разбора)
+    size_t depth;
+    size_t stack_capacity;
+    int out_of_memory;
+} json_tape;
+
+// Шаг указателя JSON (RFC 6901)
+typedef struct {
+    const char *key;        // раскрытый ключ с завершающим нулем
+    size_t length;          // длина ключа
+    uint32_t hash;          // хеш ключа для поиска в объекте
+    int is_index;           // ключ является индексом массива
+    size_t index;           // индекс массива
+} json_pointer_step;
+
+// Скомпилированный указатель JSON: шаги и ключи в одном блоке памяти
+typedef struct {
+    json_pointer_step *steps;
+    size_t count;
+} json_pointer;
+
+// Документ для разбора по требованию: при открытии строится только структурный индекс
+typedef struct {
+    json_parser parser;     // входные данные (не изменяются) и структурный индекс
+} json_lazy_doc;
+
+// Значение, разбираемое по требованию: позиция его начала в структурном индексе документа
+typedef struct {
+    const json_lazy_doc *doc;
+    size_t pos;
+} json_lazy;
+
+// Режимы записи JSON
+#define JSON_WRITE_PRETTY       0x01    // отступы табуляцией, каждый элемент контейнера с новой строки
+
+// Размер буфера, при заполнении которого данные сбрасываются в файл
+#define JSON_WRITER_FLUSH       65536
+
+// Запись JSON-текста в растущий буфер либо, если задан файл, блоками в файл
+typedef struct {
+    int fd;                 // дескриптор файла, -1 - текст накапливается в буфере
+    int error;              // ошибка записи или выделения памяти, дальнейшие данные отбрасываются
+    char *data;
+    size_t size;
+    size_t capacity;
+} json_writer;
+
+// Битовые маски классов символов блока из 64 байт входных данных
+typedef struct {
+    uint64_t quote;         // кавычки
+    uint64_t backslash;     // обратные косые черты
+    uint64_t whitespace;    // пробельные и управляющие символы
+    uint64_t op;            // структурные символы { } [ ] : ,
+} json_block_masks;
+
+// Состояние первого прохода, переносимое между блоками
+typedef struct {
+    uint64_t prev_ends_odd_backslash;   // блок закончился нечетной серией '\\'
+    uint64_t prev_inside_string;        // блок закончился внутри строки (все единицы либо 0)
+    uint64_t prev_ends_pseudo_pred;     // последний символ блока - структурный или пробельный
+} json_scan_state;
+
+typedef void (*json_classify_t)(const char *block, json_block_masks *masks);
+
+
+// Число нулевых байт, гарантированно следующих за входными данными
+#define JSON_INPUT_PADDING      64
+
+// Входные данные JSON-файла
+typedef struct {
+    char *data;         // данные файла, завершаются JSON_INPUT_PADDING нулевыми байтами
+    size_t size;        // размер данных без учета дополнения
+    size_t mapped_size; // размер отображения в память, 0 - данные размещены в куче
+    size_t capacity;    // размер буфера кучи без учета дополнения
+} json_input;
+
+// Статистика этапов преобразования (--stats). Без JSON_STATS макросы раскрываются в пустые
+// выражения и не вычисляют аргументы, так что разбор не содержит ни одной лишней инструкции
+#ifdef JSON_STATS
+
+// Этапы преобразования
+enum json_stats_phase {
+    JSON_STATS_READ,        // чтение файла
+    JSON_STATS_PARSE,       // построение дерева
+    JSON_STATS_REGULAR,     // преобразование REGULAR_CONFIG
+    JSON_STATS_PERIODICAL,  // преобразование PERIODICAL_CONFIG
+    JSON_STATS_COMMON,      // преобразование COMMON_CONFIG
+    JSON_STATS_WRITE,       // запись cfg файла
+    JSON_STATS_FREE,        // освобождение дерева
+    JSON_STATS_PHASES
+};
+
+// Замер одного этапа
+typedef struct {
+    double wall;            // астрономическое время, с
+    double cpu;             // процессорное время всех потоков, с
+    double wall_start;
+    double cpu_start;
+    uint64_t bytes;         // обработано байт
+    uint64_t items;         // обработано записей
+    int runs;               // число выполнений этапа
+} json_stats_phase_t;
+
+// Статистика процесса. Этапы замеряются только при enabled, счетчики памяти ведутся всегда
+// (атомарно, выделения возможны из нескольких потоков)
+typedef struct {
+    int enabled;
+    json_stats_phase_t phases[JSON_STATS_PHASES];
+    uint64_t nodes[TYPE_INTEGER + 1];   // узлы дерева по типам
+    uint64_t allocations;               // выделений памяти из кучи
+    uint64_t frees;                     // освобождений
+    uint64_t bytes_current;             // занято байт в куче
+    uint64_t bytes_peak;                // наибольшее значение bytes_current
+} json_stats_t;
+
+static json_stats_t json_stats;
+
+static const char *json_stats_phase_names[JSON_STATS_PHASES] = { "read", "parse", "regular", "periodical", "common",
+                                                                 "write", "free" };
+
+
+/*
+ * Функция получения значения часов в секундах
+ *
+ * Входные данные:
+ *  clock - идентификатор часов
+ *
+ * Возвращаемое значение:
+ *  время, с
+ */
+static double json_stats_clock (clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+
+/*
+ * Функция начала замера этапа
+ *
+ * Входные данные:
+ *  phase - этап
+ */
+static void json_stats_begin (int phase)
+{
+    if (!json_stats.enabled)
+        return;
+
+    json_stats.phases[phase].wall_start = json_stats_clock(CLOCK_MONOTONIC);
+    json_stats.phases[phase].cpu_start = json_stats_clock(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+
+/*
+ * Функция завершения замера этапа
+ *
+ * Входные данные:
+ *  phase - этап
+ *  bytes - обработано байт
+ *  items - обработано записей
+ */
+static void json_stats_end (int phase, uint64_t bytes, uint64_t items)
+{
+    if (!json_stats.enabled)
+        return;
+
+    json_stats_phase_t *p = &json_stats.phases[phase];
+
+    p->wall += json_stats_clock(CLOCK_MONOTONIC) - p->wall_start;
+    p->cpu += json_stats_clock(CLOCK_PROCESS_CPUTIME_ID) - p->cpu_start;
+    p->bytes += bytes;
+    p->items += items;
+    p->runs++;
+}
+
+
+/*
+ * Функция учета выделения памяти из кучи (размер берется у распределителя)
+ *
+ * Входные данные:
+ *  ptr - выделенная память (NULL не учитывается)
+ */
+static void json_stats_alloc (void *ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    uint64_t size = malloc_usable_size(ptr);
+    uint64_t current = __atomic_add_fetch(&json_stats.bytes_current, size, __ATOMIC_RELAXED);
+    uint64_t peak = __atomic_load_n(&json_stats.bytes_peak, __ATOMIC_RELAXED);
+
+    __atomic_add_fetch(&json_stats.allocations, 1, __ATOMIC_RELAXED);
+
+    while (current > peak &&
+           !__atomic_compare_exchange_n(&json_stats.bytes_peak, &peak, current, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+
+/*
+ * Функция учета освобождения памяти кучи. Вызывается до free
+ *
+ * Входные данные:
+ *  ptr - освобождаемая память (NULL не учитывается)
+ */
+static void json_stats_free (void *ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    __atomic_sub_fetch(&json_stats.bytes_current, (uint64_t)malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    __atomic_add_fetch(&json_stats.frees, 1, __ATOMIC_RELAXED);
+}
+
+
+/*
+ * Функция получения размера файла
+ *
+ * Входные данные:
+ *  path - путь к файлу
+ *
+ * Возвращаемое значение:
+ *  размер файла либо 0
+ */
+static uint64_t json_stats_file_size (const char *path)
+{
+    struct stat statbuf;
+
+    return (stat(path, &statbuf) == 0) ? (uint64_t)statbuf.st_size : 0;
+}
+
+
+/*
+ * Функция подсчета узлов дерева разбора по типам (вне замеряемых этапов)
+ *
+ * Входные данные:
+ *  value - корень поддерева
+ */
+static void json_stats_nodes (const json_value *value)
+{
+    if (!json_stats.enabled)
+        return;
+
+    json_stats.nodes[value->type]++;
+
+    if (value->type == TYPE_ARRAY || value->type == TYPE_OBJECT)
+    {
+        const json_value *items = (const json_value *)value->value.array.data;
+        size_t i = 0;
+
+        for (i = 0; i < value->value.array.size; i++)
+        {
+            // Ключи объекта хранятся строками на четных позициях пар и учитываются отдельно
+            if (value->type == TYPE_OBJECT && i % 2 == 0)
+                json_stats.nodes[TYPE_KEY]++;
+            else
+                json_stats_nodes(&items[i]);
+        }
+    }
+}
+
+#define JSON_STATS_ENABLED              (json_stats.enabled)
+#define JSON_STATS_BEGIN(phase)         json_stats_begin(phase)
+#define JSON_STATS_END(phase, bytes, items) json_stats_end(phase, bytes, items)
+#define JSON_STATS_ALLOC(ptr)           json_stats_alloc(ptr)
+#define JSON_STATS_FREE(ptr)            json_stats_free(ptr)
+#define JSON_STATS_NODES(root)          json_stats_nodes(root)
+#else
+#define JSON_STATS_ENABLED              0
+#define JSON_STATS_BEGIN(phase)         ((void)0)
+#define JSON_STATS_END(phase, bytes, items) ((void)0)
+#define JSON_STATS_ALLOC(ptr)           ((void)0)
+#define JSON_STATS_FREE(ptr)            ((void)0)
+#define JSON_STATS_NODES(root)          ((void)0)
+#endif
+
 
-int json_parse_value (const char **cursor, json_value *parent);
+int json_parse_value (json_parser *parser, json_value *parent);
 void json_free_value (json_value *val);
+void json_free_value_allocator (json_value *val, const json_allocator *allocator);
+static int json_parser_vector_reserve (json_parser *parser, vector *v, size_t new_capacity);
+int json_parse_sax_scratch (char *input, const json_sax_handler *handler, void *context, json_scratch *scratch);
+static int json_sax_parse_object (json_parser *parser);
+static int json_sax_parse_array (json_parser *parser);
+
+/*
+ * Функция чтения данных из файлового дескриптора в буфер кучи (для файлов, которые нельзя
+ * отобразить в память). Если у структуры уже есть буфер кучи (data != NULL), он используется
+ * повторно и при необходимости увеличивается, иначе выделяется новый
+ *
+ * Входные данные:
+ *  fd    - файловый дескриптор
+ *  input - структура входных данных
+ *
+ * Возвращаемое значение:
+ *  SUCCESS или DEF_ERROR (с кодом в errno), при ошибке буфер освобождается
+ */
+static int json_input_read_fd (int fd, json_input *input)
+{
+    size_t capacity = input->capacity;
+    size_t size = 0;
+    char *data = input->data;
+
+    input->data = NULL;
+    input->capacity = 0;
+
+    if (data == NULL)
+    {
+        capacity = 65536;
+        data = malloc(capacity + JSON_INPUT_PADDING);
+
+        if (data == NULL)
+            return DEF_ERROR;
+
+        JSON_STATS_ALLOC(data);
+    }
+
+    for (;;)
+    {
+        if (size == capacity)
+        {
+            JSON_STATS_FREE(data);
+
+            char *new_data = realloc(data, capacity * 2 + JSON_INPUT_PADDING);
+
+            if (new_data == NULL)
+            {
+                free(data);
+                return DEF_ERROR;
+            }
+
+            JSON_STATS_ALLOC(new_data);
+            data = new_data;
+            capacity *= 2;
+        }
+
+        ssize_t read_bytes = read(fd, data + size, capacity - size);
+
+        if (read_bytes < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            JSON_STATS_FREE(data);
+            free(data);
+            return DEF_ERROR;
+        }
+
+        if (read_bytes == 0)
+            break;
+
+        size += (size_t)read_bytes;
+    }
+
+    memset(data + size, 0, JSON_INPUT_PADDING);
+
+    input->data = data;
+    input->size = size;
+    input->mapped_size = 0;
+    input->capacity = capacity;
+
+    return SUCCESS;
+}
+
 
 /*
- * Функция получения получения размера файла по его имени
+ * Функция открытия JSON-файла. Обычный файл отображается в память без копирования,
+ * за данными гарантированно следует не менее JSON_INPUT_PADDING нулевых байт.
+ * Отображение закрытое (MAP_PRIVATE) и доступно для записи: при разборе на месте
+ * копируются только измененные страницы. Если файл не удается отобразить (sysfs, procfs,
+ * часть файловых систем FUSE и NFS), он читается в кучу.
+ * Отображение нельзя использовать для файлов, которые могут перезаписываться во время
+ * разбора: при усечении файла обращение к его страницам завершается сигналом SIGBUS
  *
  * Входные данные:
  *  file_path - полный путь к файлу
+ *  input     - структура входных данных
  *
  * Возвращаемое значение:
- *  размер файла или 0 (с кодом в errno), если произошла ошибка
+ *  SUCCESS или DEF_ERROR (с кодом в errno)
  */
-long long get_file_size (const char *file_path)
+int json_input_open (const char *file_path, json_input *input)
 {
     struct stat statbuf;
-    int fstat_res = stat(file_path, &statbuf);
+    int result = DEF_ERROR;
+
+    JSON_STATS_BEGIN(JSON_STATS_READ);
+
+    int fd = open(file_path, O_RDONLY);
 
-    if (fstat_res < 0)
+    if (fd >= 0 && fstat(fd, &statbuf) == 0)
     {
-        return 0;
+        if (S_ISREG(statbuf.st_mode) && statbuf.st_size > 0)
+        {
+            size_t size = (size_t)statbuf.st_size;
+            size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+            size_t mapped_size = (size + JSON_INPUT_PADDING + page_size - 1) & ~(page_size - 1);
+
+            // Резервирование области с нулевым хвостом, поверх которой отображается файл.
+            // Хвост последней страницы файла ядро заполняет нулями, остальное - анонимные страницы
+            char *data = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (data != MAP_FAILED)
+            {
+                if (mmap(data, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) != MAP_FAILED)
+                {
+                    madvise(data, size, MADV_SEQUENTIAL);
+
+                    input->data = data;
+                    input->size = size;
+                    input->mapped_size = mapped_size;
+                    result = SUCCESS;
+                }
+                else
+                {
+                    munmap(data, mapped_size);
+                }
+            }
+        }
+
+        // Каналы, пустые и не отображаемые в память файлы читаются в кучу
+        if (result != SUCCESS)
+        {
+            input->data = NULL;
+            result = json_input_read_fd(fd, input);
+        }
+    }
+
+    if (fd >= 0)
+        close(fd);
+
+    JSON_STATS_END(JSON_STATS_READ, (result == SUCCESS) ? input->size : 0, (result == SUCCESS));
+
+    return result;
+}
+
+
+/*
+ * Функция освобождения входных данных JSON-файла
+ *
+ * Входные данные:
+ *  input - структура входных данных
+ */
+void json_input_close (json_input *input)
+{
+    if (input->data == NULL)
+        return;
+
+    if (input->mapped_size > 0)
+    {
+        munmap(input->data, input->mapped_size);
+    }
+    else
+    {
+        JSON_STATS_FREE(input->data);
+        free(input->data);
     }
 
-    return (long long)statbuf.st_size;
+    input->data = NULL;
+    input->size = 0;
+    input->mapped_size = 0;
+    input->capacity = 0;
+}
+
+
+/*
+ * Функция чтения JSON-файла в буфер кучи, сохраняемый между вызовами. В отличие от
+ * json_input_open файл не отображается в память, поэтому его усечение или перезапись
+ * во время разбора не приводит к SIGBUS. До первого вызова структура обнуляется,
+ * буфер освобождается json_input_close
+ *
+ * Входные данные:
+ *  file_path - полный путь к файлу
+ *  input     - структура входных данных
+ *
+ * Возвращаемое значение:
+ *  SUCCESS или DEF_ERROR (с кодом в errno)
+ */
+int json_input_load (const char *file_path, json_input *input)
+{
+    int fd = open(file_path, O_RDONLY);
+
+    if (fd < 0)
+        return DEF_ERROR;
+
+    int result = json_input_read_fd(fd, input);
+
+    close(fd);
+
+    return result;
 }
 
 
@@ -217,6 +870,7 @@ void vector_init (vector *v, size_t data_size)
 
     if (v->data != NULL)
     {
+        JSON_STATS_ALLOC(v->data);
         v->capacity = 1;
         v->data_size = data_size;
         v->size = 0;
@@ -234,6 +888,7 @@ void vector_free (vector *v)
 {
     if (v)
     {
+        JSON_STATS_FREE(v->data);
         free(v->data);
         v->data = NULL;
     }
@@ -284,1500 +939,8206 @@ void vector_reserve (vector *v, size_t new_capacity)
     if (new_capacity <= v->capacity)
         return;
 
+    JSON_STATS_FREE(v->data);
+
     void *new_data = realloc(v->data, new_capacity*v->data_size);
 
     if (new_data)
     {
+        JSON_STATS_ALLOC(new_data);
         v->capacity = new_capacity;
         v->data = new_data;
     }
     else
     {
+        JSON_STATS_ALLOC(v->data);
         return;
     }
 }
 
 
 /*
- * Функция размещения элемента data[size * data_size]. Если размер size больше capacity, резервируется больше памяти
+ * Функция инициализации арены. Память выделяется при первом запросе
  *
  * Входные данные:
- *  v    - указатель на вектор
- *  data - указатель на элемент
+ *  arena      - указатель на арену
+ *  block_size - размер первого блока (не меньше JSON_ARENA_MIN_BLOCK)
  */
-static void vector_push_back (vector *v, void *data)
+void json_arena_init (json_arena *arena, size_t block_size)
 {
-    if (v->size >= v->capacity)
-    {
-        size_t new_capacity = (v->capacity > 0) ? (size_t)(v->capacity * 2) : 1;
-        vector_reserve(v, new_capacity);
-    }
-
-    memcpy(vector_get(v,v->size), data, v->data_size);
-    ++v->size;
+    arena->head = NULL;
+    arena->block_size = (block_size > JSON_ARENA_MIN_BLOCK) ? block_size : JSON_ARENA_MIN_BLOCK;
 }
 
 
 /*
- * Функция выполнения для каждого элемента вектора функции fp
+ * Функция выделения памяти из арены
  *
  * Входные данные:
- *  v  - указатель на вектор
- *  fp - указатель на функцию
+ *  arena - указатель на арену
+ *  size  - размер
+ *
+ * Возвращаемое значение:
+ *  указатель на память либо NULL
  */
-static void vector_foreach (const vector *v, vector_foreach_t fp)
+void *json_arena_alloc (json_arena *arena, size_t size)
 {
-    if (v == NULL)
-        return;
+    json_arena_block *block = arena->head;
 
-    char* item = v->data;
+    size = (size + JSON_ARENA_ALIGN - 1) & ~(size_t)(JSON_ARENA_ALIGN - 1);
 
-    if (item == NULL)
-        return;
+    if (block == NULL || block->size - block->used < size)
+    {
+        // Размер блоков растет геометрически, чтобы их число оставалось логарифмическим
+        size_t block_size = arena->block_size;
 
-    size_t i = 0;
+        if (block_size < size)
+            block_size = size;
 
-    for (i = 0; i < v->size; i++)
-    {
-        fp(item);
-        item += v->data_size;
+        block = malloc(sizeof(json_arena_block) + block_size);
+
+        if (block == NULL)
+            return NULL;
+
+        JSON_STATS_ALLOC(block);
+
+        block->next = arena->head;
+        block->size = block_size;
+        block->used = 0;
+        arena->head = block;
+        arena->block_size = block_size * 2;
     }
+
+    void *ptr = (char *)(block + 1) + block->used;
+    block->used += size;
+
+    return ptr;
 }
 
 
 /*
- * Функция пропуска пробелов и управляющих символов
+ * Функция изменения размера выделенной из арены памяти. Последнее выделение
+ * расширяется на месте, иначе данные копируются в новую область
  *
  * Входные данные:
- *  cursor - указатель на позицию в массиве с данными JSON файла
+ *  arena    - указатель на арену
+ *  ptr      - указатель на память (может быть NULL)
+ *  old_size - текущий размер
+ *  new_size - новый размер
+ *
+ * Возвращаемое значение:
+ *  указатель на память либо NULL
+ */
+void *json_arena_realloc (json_arena *arena, void *ptr, size_t old_size, size_t new_size)
+{
+    json_arena_block *block = arena->head;
+
+    if (ptr != NULL && block != NULL)
+    {
+        size_t old_aligned = (old_size + JSON_ARENA_ALIGN - 1) & ~(size_t)(JSON_ARENA_ALIGN - 1);
+        size_t new_aligned = (new_size + JSON_ARENA_ALIGN - 1) & ~(size_t)(JSON_ARENA_ALIGN - 1);
+        char *top = (char *)(block + 1) + block->used;
+
+        if ((char *)ptr + old_aligned == top && block->used - old_aligned + new_aligned <= block->size)
+        {
+            block->used = block->used - old_aligned + new_aligned;
+            return ptr;
+        }
+    }
+
+    void *new_ptr = json_arena_alloc(arena, new_size);
+
+    if (new_ptr != NULL && ptr != NULL)
+        memcpy(new_ptr, ptr, (old_size < new_size) ? old_size : new_size);
+
+    return new_ptr;
+}
+
+
+/*
+ * Функция сброса арены для повторного использования. Все выделенное ранее становится недействительным.
+ * Если арена состояла из нескольких блоков, они заменяются одним блоком суммарного размера,
+ * поэтому повторный разбор документа того же размера не обращается к куче
+ *
+ * Входные данные:
+ *  arena - указатель на арену
+ */
+void json_arena_reset (json_arena *arena)
+{
+    json_arena_block *block = arena->head;
+
+    if (block == NULL)
+        return;
+
+    if (block->next == NULL)
+    {
+        block->used = 0;
+        return;
+    }
+
+    size_t total = 0;
+
+    while (block != NULL)
+    {
+        json_arena_block *next = block->next;
+        total += block->size;
+        JSON_STATS_FREE(block);
+        free(block);
+        block = next;
+    }
+
+    arena->head = NULL;
+    arena->block_size = total;
+
+    block = malloc(sizeof(json_arena_block) + total);
+
+    if (block != NULL)
+    {
+        JSON_STATS_ALLOC(block);
+        block->next = NULL;
+        block->size = total;
+        block->used = 0;
+        arena->head = block;
+    }
+}
+
+
+/*
+ * Функция передачи всех блоков другой арены в арену. Выделенная в other память остается действительной
+ * и освобождается вместе с arena, other становится пустой. Текущий блок arena сохраняется
+ *
+ * Входные данные:
+ *  arena - указатель на арену
+ *  other - арена, блоки которой передаются
+ */
+void json_arena_adopt (json_arena *arena, json_arena *other)
+{
+    json_arena_block *tail = other->head;
+
+    if (tail == NULL)
+        return;
+
+    while (tail->next != NULL)
+        tail = tail->next;
+
+    if (arena->head == NULL)
+    {
+        arena->head = other->head;
+    }
+    else
+    {
+        tail->next = arena->head->next;
+        arena->head->next = other->head;
+    }
+
+    other->head = NULL;
+}
+
+
+/*
+ * Функция освобождения всей памяти арены
+ *
+ * Входные данные:
+ *  arena - указатель на арену
+ */
+void json_arena_release (json_arena *arena)
+{
+    json_arena_block *block = arena->head;
+
+    while (block != NULL)
+    {
+        json_arena_block *next = block->next;
+        JSON_STATS_FREE(block);
+        free(block);
+        block = next;
+    }
+
+    arena->head = NULL;
+}
+
+
+/*
+ * Функции распределителя поверх арены (см. json_arena_alloc и json_arena_realloc)
+ */
+static void *json_arena_allocator_alloc (void *context, size_t size)
+{
+    return json_arena_alloc(context, size);
+}
+
+
+static void *json_arena_allocator_realloc (void *context, void *ptr, size_t old_size, size_t new_size)
+{
+    return json_arena_realloc(context, ptr, old_size, new_size);
+}
+
+
+/*
+ * Функция получения распределителя, выделяющего память из арены. Память освобождается
+ * только вместе с ареной
+ *
+ * Входные данные:
+ *  arena - указатель на арену
+ *
+ * Возвращаемое значение:
+ *  распределитель
+ */
+json_allocator json_arena_allocator (json_arena *arena)
+{
+    json_allocator allocator = { json_arena_allocator_alloc, json_arena_allocator_realloc, NULL, arena };
+
+    return allocator;
+}
+
+
+/*
+ * Функция освобождения памяти распределителем (NULL - куча)
+ *
+ * Входные данные:
+ *  allocator - распределитель
+ *  ptr       - указатель на память
+ */
+static void json_allocator_free (const json_allocator *allocator, void *ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    if (allocator == NULL)
+    {
+        JSON_STATS_FREE(ptr);
+        free(ptr);
+    }
+    else if (allocator->free != NULL)
+    {
+        allocator->free(allocator->context, ptr);
+    }
+}
+
+
+/*
+ * Функция выделения памяти при разборе: распределителем, если он задан, иначе из кучи
+ *
+ * Входные данные:
+ *  parser - состояние разбора
+ *  size   - размер
+ *
+ * Возвращаемое значение:
+ *  указатель на память либо NULL
+ */
+static void *json_parser_alloc (json_parser *parser, size_t size)
+{
+    if (parser->allocator != NULL)
+        return parser->allocator->alloc(parser->allocator->context, size);
+
+    void *ptr = malloc(size);
+
+    JSON_STATS_ALLOC(ptr);
+
+    return ptr;
+}
+
+
+/*
+ * Функция освобождения памяти, выделенной json_parser_alloc (память арены не освобождается)
+ *
+ * Входные данные:
+ *  parser - состояние разбора
+ *  ptr    - указатель на память
+ */
+static void json_parser_free (json_parser *parser, void *ptr)
+{
+    json_allocator_free(parser->allocator, ptr);
+}
+
+
+/*
+ * Функция получения распределителя для временных буферов разбора (структурный индекс,
+ * таблица разбиения). Память распределителя без free (арены) освобождается только вместе
+ * с деревом, поэтому временные буферы в этом случае выделяются из кучи
+ *
+ * Входные данные:
+ *  parser - состояние разбора
+ *
+ * Возвращаемое значение:
+ *  распределитель либо NULL (куча)
+ */
+static const json_allocator *json_parser_temp_allocator (const json_parser *parser)
+{
+    return (parser->allocator != NULL && parser->allocator->free != NULL) ? parser->allocator : NULL;
+}
+
+
+/*
+ * Функция выделения временного буфера разбора (освобождается json_allocator_free
+ * с распределителем json_parser_temp_allocator)
+ *
+ * Входные данные:
+ *  parser - состояние разбора
+ *  size   - размер
+ *
+ * Возвращаемое значение:
+ *  указатель на память либо NULL
+ */
+static void *json_parser_temp_alloc (const json_parser *parser, size_t size)
+{
+    const json_allocator *allocator = json_parser_temp_allocator(parser);
+
+    if (allocator != NULL)
+        return allocator->alloc(allocator->context, size);
+
+    void *ptr = malloc(size);
+
+    JSON_STATS_ALLOC(ptr);
+
+    return ptr;
+}
+
+
+/*
+ * Функция получения флагов создаваемых при разборе узлов: память узлов, выделенная
+ * распределителем без free, освобождается его владельцем
+ *
+ * Входные данные:
+ *  parser - состояние разбора
+ *
+ * Возвращаемое значение:
+ *  JSON_FLAG_BORROWED или 0
+ */
+static inline int json_parser_node_flags (const json_parser *parser)
+{
+    return (parser->allocator != NULL && parser->allocator->free == NULL) ? JSON_FLAG_BORROWED : 0;
+}
+
+
+/*
+ * Функция инициализации вектора дочерних узлов контейнера. Если число элементов известно,
+ * память выделяется сразу одним блоком, иначе (и для пустого контейнера) - при первом добавлении
+ *
+ * Входные данные:
+ *  parser   - состояние разбора
+ *  v        - указатель на вектор
+ *  capacity - ожидаемое число узлов (0 - неизвестно)
+ */
+static void json_parser_vector_init (json_parser *parser, vector *v, size_t capacity)
+{
+    v->capacity = 0;
+    v->data_size = sizeof(json_value);
+    v->size = 0;
+    v->data = NULL;
+
+    // При ошибке выделения вектор остается пустым, ошибка проявится при добавлении
+    if (capacity > 0)
+        json_parser_vector_reserve(parser, v, capacity);
+}
+
+
+/*
+ * Функция резервирования вместимости вектора дочерних узлов контейнера
+ *
+ * Входные данные:
+ *  parser       - состояние разбора
+ *  v            - указатель на вектор
+ *  new_capacity - значение вместимости
+ *
+ * Возвращаемое значение:
+ *  1 - вместимость не меньше new_capacity, иначе 0
+ */
+static int json_parser_vector_reserve (json_parser *parser, vector *v, size_t new_capacity)
+{
+    if (new_capacity <= v->capacity)
+        return 1;
+
+    if (parser->allocator == NULL)
+    {
+        vector_reserve(v, new_capacity);
+        return (v->capacity >= new_capacity);
+    }
+
+    void *new_data = parser->allocator->realloc(parser->allocator->context, v->data, v->capacity * v->data_size,
+                                                new_capacity * v->data_size);
+
+    if (new_data == NULL)
+        return 0;
+
+    v->data = new_data;
+    v->capacity = new_capacity;
+
+    return 1;
+}
+
+
+/*
+ * Функция добавления дочернего узла в вектор контейнера
+ *
+ * Входные данные:
+ *  parser - состояние разбора
+ *  v      - указатель на вектор
+ *  value  - добавляемый узел
+ *
+ * Возвращаемое значение:
+ *  1 - при успешном добавлении, иначе 0
+ */
+static int json_parser_vector_push (json_parser *parser, vector *v, json_value *value)
+{
+    if (v->size >= v->capacity)
+    {
+        size_t new_capacity = (v->capacity > 0) ? v->capacity * 2 : 4;
+
+        if (!json_parser_vector_reserve(parser, v, new_capacity))
+            return 0;
+    }
+
+    memcpy(vector_get(v, v->size), value, v->data_size);
+    ++v->size;
+
+    return 1;
+}
+
+
+/*
+ * Функция вычисления хеша строки (по 8 байт за шаг)
+ *
+ * Входные данные:
+ *  data   - начало строки
+ *  length - длина строки
+ *
+ * Возвращаемое значение:
+ *  хеш строки
+ */
+static uint32_t json_hash_string (const char *data, size_t length)
+{
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ length;
+    uint64_t word = 0;
+
+    while (length >= 8)
+    {
+        memcpy(&word, data, 8);
+        hash = (hash ^ word) * 0xBF58476D1CE4E5B9ULL;
+        hash ^= hash >> 29;
+        data += 8;
+        length -= 8;
+    }
+
+    word = 0;
+    memcpy(&word, data, length);
+    hash = (hash ^ word) * 0x94D049BB133111EBULL;
+    hash ^= hash >> 32;
+
+    return (uint32_t)hash;
+}
+
+
+/*
+ * Функция получения размера хеш-таблицы ключей объекта (степень двойки, не меньше удвоенного числа пар)
+ *
+ * Входные данные:
+ *  pairs - число пар ключ-значение
+ *
+ * Возвращаемое значение:
+ *  число ячеек таблицы
+ */
+static size_t json_object_index_slots (size_t pairs)
+{
+    size_t slots = 1;
+
+    while (slots < pairs * 2)
+        slots <<= 1;
+
+    return slots;
+}
+
+
+/*
+ * Функция вычисления места под хеш-таблицу ключей за парами объекта
+ *
+ * Входные данные:
+ *  pairs - число пар ключ-значение
+ *
+ * Возвращаемое значение:
+ *  число узлов, занимаемых таблицей
+ */
+static size_t json_object_index_extra (size_t pairs)
+{
+    size_t slots_size = json_object_index_slots(pairs) * sizeof(uint32_t);
+
+    return (slots_size + sizeof(json_value) - 1) / sizeof(json_value);
+}
+
+
+/*
+ * Функция заполнения хеш-таблицы ключей объекта. Пары вставляются по порядку,
+ * поэтому при повторяющихся ключах находится первый, как и при линейном поиске
+ *
+ * Входные данные:
+ *  object - объект с зарезервированной таблицей
+ */
+static void json_object_index_build (json_value *object)
+{
+    json_value *data = (json_value *)object->value.object.data;
+    size_t size = object->value.object.size;
+    size_t mask = json_object_index_slots(size / 2) - 1;
+    uint32_t *slots = (uint32_t *)(data + size);
+    size_t i = 0;
+
+    memset(slots, 0, (mask + 1) * sizeof(uint32_t));
+
+    for (i = 0; i < size; i += 2)
+    {
+        size_t slot = data[i].value.string.hash & mask;
+
+        while (slots[slot] != 0)
+            slot = (slot + 1) & mask;
+
+        slots[slot] = (uint32_t)(i + 1);
+    }
+}
+
+
+/*
+ * Функция построения хеш-таблицы ключей за парами большого объекта при его завершении.
+ * После разбора дерево только читается, поэтому поиск по ключу потокобезопасен.
+ * При ошибке выделения объект остается без таблицы
+ *
+ * Входные данные:
+ *  parser - состояние разбора
+ *  object - объект
+ */
+static void json_parser_build_object_index (json_parser *parser, json_value *object)
+{
+    vector *v = &object->value.object;
+
+    if (json_parser_vector_reserve(parser, v, v->size + json_object_index_extra(v->size / 2)))
+    {
+        json_object_index_build(object);
+        object->flags |= JSON_FLAG_INDEXED;
+    }
+}
+
+
+/*
+ * Функция проверки, является ли символ пробельным или управляющим (не зависит от локали)
+ *
+ * Входные данные:
+ *  c - символ
+ *
+ * Возвращаемое значение:
+ *  1 - символ пробельный, иначе 0
+ */
+static inline int json_is_whitespace (unsigned char c)
+{
+    return ((unsigned char)(c - 1) < 0x20) || (c == 0x7F);
+}
+
+
+/*
+ * Функция проверки, является ли символ структурным
+ *
+ * Входные данные:
+ *  c - символ
+ *
+ * Возвращаемое значение:
+ *  1 - символ структурный, иначе 0
+ */
+static inline int json_is_op (unsigned char c)
+{
+    return (c == '{') || (c == '}') || (c == '[') || (c == ']') || (c == ':') || (c == ',');
+}
+
+
+/*
+ * Функция проверки, может ли символ следовать за скалярным значением
+ *
+ * Входные данные:
+ *  c - символ
+ *
+ * Возвращаемое значение:
+ *  1 - символ пробельный, структурный или завершающий нуль, иначе 0
+ */
+static inline int json_is_value_end (unsigned char c)
+{
+    return (c == '\0') || json_is_whitespace(c) || json_is_op(c);
+}
+
+
+#ifndef JSON_SIMD_X86
+/*
+ * Функция классификации символов блока из 64 байт (без векторных инструкций)
+ *
+ * Входные данные:
+ *  block - указатель на блок
+ *  masks - битовые маски классов символов (выходной параметр)
+ */
+static void json_classify_scalar (const char *block, json_block_masks *masks)
+{
+    uint64_t quote = 0;
+    uint64_t backslash = 0;
+    uint64_t whitespace = 0;
+    uint64_t op = 0;
+    int i = 0;
+
+    for (i = 0; i < 64; i++)
+    {
+        unsigned char c = (unsigned char)block[i];
+        uint64_t bit = (uint64_t)1 << i;
+
+        if (c == '"')
+            quote |= bit;
+        else if (c == '\\')
+            backslash |= bit;
+        else if (json_is_whitespace(c))
+            whitespace |= bit;
+        else if (json_is_op(c))
+            op |= bit;
+    }
+
+    masks->quote = quote;
+    masks->backslash = backslash;
+    masks->whitespace = whitespace;
+    masks->op = op;
+}
+#endif
+
+
+#ifdef JSON_SIMD_X86
+/*
+ * Функция классификации символов блока из 64 байт (SSE2, по 16 байт)
+ *
+ * Входные данные:
+ *  block - указатель на блок
+ *  masks - битовые маски классов символов (выходной параметр)
+ */
+static void json_classify_sse2 (const char *block, json_block_masks *masks)
+{
+    const __m128i quote_char = _mm_set1_epi8('"');
+    const __m128i backslash_char = _mm_set1_epi8('\\');
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i open_brace = _mm_set1_epi8('{');   // '[' | 0x20 == '{'
+    const __m128i close_brace = _mm_set1_epi8('}');  // ']' | 0x20 == '}'
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i space_limit = _mm_set1_epi8(0x21);
+    const __m128i del = _mm_set1_epi8(0x7F);
+    uint64_t quote = 0;
+    uint64_t backslash = 0;
+    uint64_t whitespace = 0;
+    uint64_t op = 0;
+    int i = 0;
+
+    for (i = 0; i < 4; i++)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(block + i * 16));
+        __m128i folded = _mm_or_si128(v, case_bit);
+        int shift = i * 16;
+
+        __m128i is_op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, open_brace), _mm_cmpeq_epi8(folded, close_brace)),
+                                     _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)));
+        // Байты 0x01..0x20 как знаковые числа лежат в (0, 0x21), байты >= 0x80 отрицательны
+        __m128i is_ws = _mm_or_si128(_mm_and_si128(_mm_cmpgt_epi8(v, zero), _mm_cmplt_epi8(v, space_limit)),
+                                     _mm_cmpeq_epi8(v, del));
+
+        quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote_char)) << shift;
+        backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash_char)) << shift;
+        whitespace |= (uint64_t)(uint16_t)_mm_movemask_epi8(is_ws) << shift;
+        op |= (uint64_t)(uint16_t)_mm_movemask_epi8(is_op) << shift;
+    }
+
+    masks->quote = quote;
+    masks->backslash = backslash;
+    masks->whitespace = whitespace;
+    masks->op = op;
+}
+
+
+/*
+ * Функция классификации символов блока из 64 байт (AVX2, по 32 байта)
+ *
+ * Входные данные:
+ *  block - указатель на блок
+ *  masks - битовые маски классов символов (выходной параметр)
+ */
+__attribute__((target("avx2")))
+static void json_classify_avx2 (const char *block, json_block_masks *masks)
+{
+    const __m256i quote_char = _mm256_set1_epi8('"');
+    const __m256i backslash_char = _mm256_set1_epi8('\\');
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i open_brace = _mm256_set1_epi8('{');
+    const __m256i close_brace = _mm256_set1_epi8('}');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i space_limit = _mm256_set1_epi8(0x21);
+    const __m256i del = _mm256_set1_epi8(0x7F);
+    uint64_t quote = 0;
+    uint64_t backslash = 0;
+    uint64_t whitespace = 0;
+    uint64_t op = 0;
+    int i = 0;
+
+    for (i = 0; i < 2; i++)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(block + i * 32));
+        __m256i folded = _mm256_or_si256(v, case_bit);
+        int shift = i * 32;
+
+        __m256i is_op = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(folded, open_brace), _mm256_cmpeq_epi8(folded, close_brace)),
+                                        _mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, comma)));
+        __m256i is_ws = _mm256_or_si256(_mm256_and_si256(_mm256_cmpgt_epi8(v, zero), _mm256_cmpgt_epi8(space_limit, v)),
+                                        _mm256_cmpeq_epi8(v, del));
+
+        quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote_char)) << shift;
+        backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash_char)) << shift;
+        whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_ws) << shift;
+        op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_op) << shift;
+    }
+
+    masks->quote = quote;
+    masks->backslash = backslash;
+    masks->whitespace = whitespace;
+    masks->op = op;
+}
+#endif
+
+
+/*
+ * Функция выбора реализации классификации символов по возможностям процессора.
+ * Выполняется один раз, результат запоминается
+ *
+ * Возвращаемое значение:
+ *  указатель на функцию классификации
+ */
+static json_classify_t json_select_classifier (void)
+{
+    static json_classify_t classify = NULL;
+
+    if (classify == NULL)
+    {
+#ifdef JSON_SIMD_X86
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2"))
+            classify = json_classify_avx2;
+        else
+            classify = json_classify_sse2;
+#else
+        classify = json_classify_scalar;
+#endif
+    }
+
+    return classify;
+}
+
+
+/*
+ * Функция вычисления маски значимых позиций блока: структурных символов вне строк,
+ * открывающих и закрывающих кавычек и начал скалярных значений (чисел, true, false, null)
+ *
+ * Входные данные:
+ *  masks - битовые маски классов символов блока
+ *  state - состояние, переносимое между блоками
+ *
+ * Возвращаемое значение:
+ *  битовая маска значимых позиций
+ */
+static inline uint64_t json_block_structurals (const json_block_masks *masks, json_scan_state *state)
+{
+    const uint64_t even_bits = 0x5555555555555555ULL;
+    const uint64_t odd_bits = ~even_bits;
+    uint64_t bs = masks->backslash;
+
+    // Поиск символов, экранированных нечетной серией обратных косых черт
+    uint64_t start_edges = bs & ~(bs << 1);
+    uint64_t even_start_mask = even_bits ^ state->prev_ends_odd_backslash;
+    uint64_t even_starts = start_edges & even_start_mask;
+    uint64_t odd_starts = start_edges & ~even_start_mask;
+    uint64_t even_carries = bs + even_starts;
+    uint64_t odd_carries = bs + odd_starts;
+    uint64_t ends_odd_backslash = (odd_carries < bs) ? 1 : 0;
+
+    odd_carries |= state->prev_ends_odd_backslash;
+    state->prev_ends_odd_backslash = ends_odd_backslash;
+
+    uint64_t odd_ends = ((even_carries & ~bs) & odd_bits) | ((odd_carries & ~bs) & even_bits);
+
+    // Маска внутренности строк: префиксный XOR по неэкранированным кавычкам
+    uint64_t quote = masks->quote & ~odd_ends;
+    uint64_t in_string = quote;
+
+    in_string ^= in_string << 1;
+    in_string ^= in_string << 2;
+    in_string ^= in_string << 4;
+    in_string ^= in_string << 8;
+    in_string ^= in_string << 16;
+    in_string ^= in_string << 32;
+    in_string ^= state->prev_inside_string;
+    state->prev_inside_string = (uint64_t)((int64_t)in_string >> 63);
+
+    // Структурные символы вне строк и все неэкранированные кавычки
+    uint64_t structurals = (masks->op & ~in_string) | quote;
+
+    // Начала скаляров: непробельный символ вне строки после структурного или пробельного
+    uint64_t pseudo_pred = structurals | masks->whitespace;
+    uint64_t shifted_pseudo_pred = (pseudo_pred << 1) | state->prev_ends_pseudo_pred;
+
+    state->prev_ends_pseudo_pred = pseudo_pred >> 63;
+
+    return structurals | (shifted_pseudo_pred & ~masks->whitespace & ~in_string & ~quote);
+}
+
+
+/*
+ * Функция построения структурного индекса (первый проход разбора). Входные данные обрабатываются
+ * блоками по 64 байта векторными инструкциями, лучший набор которых выбирается во время выполнения.
+ * Индекс завершается смещениями конца данных, где находится завершающий нуль
+ *
+ * Входные данные:
+ *  parser - состояние разбора
+ *  input  - начало входных данных
+ *  size   - размер входных данных
+ *
+ * Возвращаемое значение:
+ *  1 - индекс построен, 0 - индекс недоступен (разбор выполняется посимвольно)
+ */
+static int json_build_structural_index (json_parser *parser, const char *input, size_t size)
+{
+    if (size >= UINT32_MAX - 64)
+        return 0;
+
+    // Число значимых позиций не превышает числа байт, плюс два завершающих элемента
+    json_scratch *scratch = parser->scratch;
+    uint32_t *positions = NULL;
+
+    if (scratch != NULL && scratch->capacity >= size + 2)
+    {
+        positions = scratch->structurals;
+    }
+    else if (scratch != NULL)
+    {
+        // Буферы json_scratch переживают разбор и распределитель, поэтому всегда берутся из кучи
+        positions = malloc((size + 2) * sizeof(uint32_t));
+
+        if (positions == NULL)
+            return 0;
+
+        JSON_STATS_ALLOC(positions);
+        JSON_STATS_FREE(scratch->structurals);
+        free(scratch->structurals);
+        scratch->structurals = positions;
+        scratch->capacity = size + 2;
+    }
+    else
+    {
+        positions = json_parser_temp_alloc(parser, (size + 2) * sizeof(uint32_t));
+
+        if (positions == NULL)
+            return 0;
+    }
+
+    json_classify_t classify = json_select_classifier();
+    json_scan_state state = { 0, 0, 1 };
+    json_block_masks masks;
+    size_t count = 0;
+    size_t offset = 0;
+
+    for (offset = 0; offset < size; offset += 64)
+    {
+        uint64_t bits;
+
+        if (size - offset >= 64)
+        {
+            classify(input + offset, &masks);
+            bits = json_block_structurals(&masks, &state);
+        }
+        else
+        {
+            // Последний неполный блок копируется, чтобы не читать за пределами данных
+            char tail[64];
+
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, input + offset, size - offset);
+            classify(tail, &masks);
+            bits = json_block_structurals(&masks, &state) & (((uint64_t)1 << (size - offset)) - 1);
+        }
+
+        while (bits != 0)
+        {
+            positions[count++] = (uint32_t)offset + (uint32_t)__builtin_ctzll(bits);
+            bits &= bits - 1;
+        }
+    }
+
+    positions[count++] = (uint32_t)size;
+    positions[count++] = (uint32_t)size;
+
+    parser->base = input;
+    parser->structurals = positions;
+    parser->structural_pos = 0;
+    parser->structural_count = count - 2;
+
+    return 1;
+}
+
+
+/*
+ * Функция освобождения структурного индекса (память из json_scratch сохраняется)
+ *
+ * Входные данные:
+ *  parser - состояние разбора
+ */
+static void json_release_structural_index (json_parser *parser)
+{
+    if (parser->scratch == NULL || parser->structurals != parser->scratch->structurals)
+        json_allocator_free(json_parser_temp_allocator(parser), parser->structurals);
+
+    parser->structurals = NULL;
+}
+
+
+/*
+ * Функция поиска массива для параллельного разбора: по структурному индексу (строки в нем
+ * уже исключены) выбирается массив с наибольшим числом элементов на глубине до
+ * JSON_SPLIT_MAX_DEPTH, затем собираются позиции начала его элементов. Число потоков
+ * уменьшается так, чтобы на каждый приходилось не меньше JSON_SPLIT_MIN_ELEMENTS элементов
+ *
+ * Входные данные:
+ *  parser  - состояние разбора с построенным индексом
+ *  split   - разбиение (выходной параметр)
+ *  threads - наибольшее число потоков
+ *
+ * Возвращаемое значение:
+ *  1 - массив найден и делится хотя бы на две части, иначе 0
+ */
+static int json_find_split (const json_parser *parser, json_split *split, int threads)
+{
+    size_t open[JSON_SPLIT_MAX_DEPTH];
+    size_t commas[JSON_SPLIT_MAX_DEPTH];
+    int is_array[JSON_SPLIT_MAX_DEPTH];
+    size_t depth = 0;
+    size_t best_commas = 0;
+    size_t i = 0;
+
+    memset(split, 0, sizeof(*split));
+
+    if (parser->structurals == NULL || threads < 2)
+        return 0;
+
+    for (i = 0; i < parser->structural_count; i++)
+    {
+        char c = parser->base[parser->structurals[i]];
+
+        if (c == '[' || c == '{')
+        {
+            if (depth < JSON_SPLIT_MAX_DEPTH)
+            {
+                open[depth] = i;
+                commas[depth] = 0;
+                is_array[depth] = (c == '[');
+            }
+
+            depth++;
+        }
+        else if (c == ']' || c == '}')
+        {
+            if (depth == 0)
+                return 0;
+
+            depth--;
+
+            if (depth < JSON_SPLIT_MAX_DEPTH && is_array[depth] && c == ']' && commas[depth] >= best_commas)
+            {
+                best_commas = commas[depth];
+                split->open = open[depth];
+                split->close = i;
+            }
+        }
+        else if (c == ',' && depth > 0 && depth <= JSON_SPLIT_MAX_DEPTH)
+        {
+            commas[depth - 1]++;
+        }
+    }
+
+    size_t elements = best_commas + 1;
+    size_t parts = elements / JSON_SPLIT_MIN_ELEMENTS;
+
+    if (parts > (size_t)threads)
+        parts = (size_t)threads;
+
+    if (parts > JSON_SPLIT_MAX_THREADS)
+        parts = JSON_SPLIT_MAX_THREADS;
+
+    if (split->close == 0 || parts < 2)
+        return 0;
+
+    split->starts = json_parser_temp_alloc(parser, elements * sizeof(size_t));
+
+    if (split->starts == NULL)
+        return 0;
+
+    // Начала элементов: после '[' и после каждой запятой самого массива
+    split->starts[split->count++] = split->open + 1;
+    depth = 0;
+
+    for (i = split->open + 1; i < split->close; i++)
+    {
+        char c = parser->base[parser->structurals[i]];
+
+        if (c == '[' || c == '{')
+            depth++;
+        else if (c == ']' || c == '}')
+            depth--;
+        else if (c == ',' && depth == 0 && split->count < elements)
+            split->starts[split->count++] = i + 1;
+    }
+
+    split->threads = (int)parts;
+
+    return 1;
+}
+
+
+/*
+ * Функция пропуска пробелов и управляющих символов
+ *
+ * Входные данные:
+ *  cursor - указатель на позицию в массиве с данными JSON файла
+ */
+static void skip_whitespace (const char **cursor)
+{
+    while (json_is_whitespace((unsigned char)**cursor))
+        ++(*cursor);
+}
+
+
+/*
+ * Функция проверки наличия символа в строке
+ *
+ * Входные данные:
+ *  cursor    - указатель на позицию в массиве с данными JSON файла
+ *  character - символ
+ *
+ * Возвращаемое значение:
+ *  положительное значение при наличии символа, иначе 0
+ */
+static int has_char (const char **cursor, char character)
+{
+    skip_whitespace(cursor);
+    int success = (**cursor == character);
+
+    if (success)
+        ++(*cursor);
+
+    return success;
+}
+
+
+/*
+ * Функция перехода к следующему значимому символу: по структурному индексу, если он построен,
+ * иначе пропуском пробелов
+ *
+ * Входные данные:
+ *  parser - состояние разбора
+ */
+static inline void json_parser_skip_whitespace (json_parser *parser)
+{
+    if (parser->structurals != NULL)
+        parser->cursor = parser->base + parser->structurals[parser->structural_pos];
+    else
+        skip_whitespace(&parser->cursor);
+}
+
+
+/*
+ * Функция проверки наличия символа в следующей значимой позиции. При наличии символ пропускается
+ *
+ * Входные данные:
+ *  parser    - состояние разбора
+ *  character - символ
+ *
+ * Возвращаемое значение:
+ *  положительное значение при наличии символа, иначе 0
+ */
+static inline int json_parser_has_char (json_parser *parser, char character)
+{
+    if (parser->structurals == NULL)
+        return has_char(&parser->cursor, character);
+
+    const char *token = parser->base + parser->structurals[parser->structural_pos];
+
+    if (*token != character)
+        return 0;
+
+    parser->structural_pos++;
+    parser->cursor = token + 1;
+
+    return 1;
+}
+
+
+/*
+ * Функция подсчета элементов открытого контейнера по структурному индексу: считаются запятые
+ * на уровне контейнера до его закрывающей скобки. Просматривается не больше JSON_PRESCAN_LIMIT
+ * элементов индекса, поэтому подсчет стоит не больше самого разбора небольших контейнеров
+ *
+ * Входные данные:
+ *  parser - состояние разбора (открывающая скобка уже пропущена)
+ *
+ * Возвращаемое значение:
+ *  число элементов массива или пар объекта, 0 - контейнер пуст, не закрывается в пределах
+ *  просмотра либо индекс не построен
+ */
+static size_t json_prescan_count (const json_parser *parser)
+{
+    size_t depth = 0;
+    size_t commas = 0;
+    size_t i = parser->structural_pos;
+
+    if (parser->structurals == NULL)
+        return 0;
+
+    size_t end = i + JSON_PRESCAN_LIMIT;
+
+    if (end > parser->structural_count)
+        end = parser->structural_count;
+
+    for (; i < end; i++)
+    {
+        char c = parser->base[parser->structurals[i]];
+
+        if (c == '[' || c == '{')
+        {
+            depth++;
+        }
+        else if (c == ']' || c == '}')
+        {
+            if (depth == 0)
+                return (i == parser->structural_pos) ? 0 : commas + 1;
+
+            depth--;
+        }
+        else if (c == ',' && depth == 0)
+        {
+            commas++;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Функция поиска объекта в JSON файле
+ *
+ * Входные данные:
+ *  parser - состояние разбора
+ *  parent - родительский объект
+ *
+ * Возвращаемое значение:
+ *  положительное значение при наличии символа, иначе 0
+ */
+static int json_parse_object (json_parser *parser, json_value *parent)
+{
+    json_value result = { .type = TYPE_OBJECT, .flags = json_parser_node_flags(parser) };
+    size_t pairs = json_prescan_count(parser);
+
+    // Пары и хеш-таблица ключей большого объекта размещаются одним блоком
+    if (pairs >= JSON_OBJECT_INDEX_MIN_PAIRS)
+        json_parser_vector_init(parser, &result.value.object, pairs * 2 + json_object_index_extra(pairs));
+    else
+        json_parser_vector_init(parser, &result.value.object, pairs * 2);
+
+    int success = 1;
+
+    while (success && !json_parser_has_char(parser, '}'))
+    {
+        json_value key = { .type = TYPE_NULL };
+        json_value value = { .type = TYPE_NULL };
+        success = json_parse_value(parser, &key);
+        success = (success && key.type == TYPE_STRING);
+        success = (success && json_parser_has_char(parser, ':'));
+
+        if (success)
+            key.value.string.hash = json_hash_string(key.value.string.data, key.value.string.length);
+
+        success = (success && json_parse_value(parser, &value));
+
+        if (!success)
+        {
+            json_free_value_allocator(&key, parser->allocator);
+            break;
+        }
+
+        // Добавленные узлы освобождаются вместе с объектом, остальные - отдельно
+        if (!json_parser_vector_push(parser, &result.value.object, &key))
+        {
+            json_free_value_allocator(&key, parser->allocator);
+            json_free_value_allocator(&value, parser->allocator);
+            success = 0;
+            break;
+        }
+
+        if (!json_parser_vector_push(parser, &result.value.object, &value))
+        {
+            json_free_value_allocator(&value, parser->allocator);
+            success = 0;
+            break;
+        }
+
+        if (json_parser_has_char(parser, '}'))
+            break;
+        else if (json_parser_has_char(parser, ','))
+            continue;
+        else
+            success = 0;
+    }
+
+    if (success)
+    {
+        if (result.value.object.size / 2 >= JSON_OBJECT_INDEX_MIN_PAIRS)
+            json_parser_build_object_index(parser, &result);
+
+        *parent = result;
+    }
+    else
+    {
+        json_free_value_allocator(&result, parser->allocator);
+    }
+
+    return success;
+}
+
+
+/*
+ * Функция поиска массива в JSON файле
+ *
+ * Входные данные:
+ *  parser - состояние разбора
+ *  parent - родительский объект
+ *
+ * Возвращаемое значение:
+ *  положительное значение при наличии символа, иначе 0
+ */
+static int json_parse_array (json_parser *parser, json_value *parent)
+{
+    int success = 1;
+
+    if (json_parser_has_char(parser, ']'))
+        return success;
+
+    while (success)
+    {
+        json_value new_value = { .type = TYPE_NULL };
+        success = json_parse_value(parser, &new_value);
+
+        if (!success)
+            break;
+
+        success = json_parser_vector_push(parser, &parent->value.array, &new_value);
+
+        if (!success)
+        {
+            json_free_value_allocator(&new_value, parser->allocator);
+            break;
+        }
+
+        if (json_parser_has_char(parser, ']'))
+            break;
+        else if (json_parser_has_char(parser, ','))
+            continue;
+        else
+            success = 0;
+    }
+
+    return success;
+}
+
+
+// Задание потока параллельного разбора: элементы массива [begin, end)
+typedef struct {
+    json_parser parser;     // собственное состояние разбора (общие вход и индекс)
+    json_arena arena;       // собственная арена потока
+    json_allocator allocator;   // распределитель поверх арены потока
+    json_value *values;     // элементы массива-результата
+    size_t begin;
+    size_t end;
+    size_t parsed;          // число разобранных элементов
+    size_t next;            // элемент индекса, которым должна закончиться часть (',' или ']')
+    int success;
+} json_split_job;
+
+
+/*
+ * Функция разбора части элементов массива в отдельном потоке
+ *
+ * Входные данные:
+ *  arg - задание (json_split_job)
+ *
+ * Возвращаемое значение:
+ *  NULL
+ */
+static void *json_split_worker (void *arg)
+{
+    json_split_job *job = arg;
+    json_parser *parser = &job->parser;
+    size_t i = 0;
+
+    job->success = 1;
+
+    for (i = job->begin; job->success && i < job->end; i++)
+    {
+        job->values[i].type = TYPE_NULL;
+        job->values[i].flags = 0;
+        job->success = json_parse_value(parser, &job->values[i]);
+
+        if (job->success)
+            job->parsed++;
+
+        // После элемента - запятая, за последним элементом части - граница следующей части
+        if (job->success && i + 1 < job->end)
+            job->success = json_parser_has_char(parser, ',');
+    }
+
+    job->success = job->success && (parser->structural_pos == job->next);
+
+    return NULL;
+}
+
+
+/*
+ * Функция параллельного разбора массива, найденного json_find_split. Элементы делятся на
+ * непрерывные части по числу потоков, каждая разбирается в свою арену прямо в итоговый
+ * вектор, затем арены потоков передаются арене разбора. Порядок элементов сохраняется
+ *
+ * Входные данные:
+ *  parser - состояние разбора (открывающая скобка уже пропущена)
+ *  parent - узел массива
+ *
+ * Возвращаемое значение:
+ *  1 - при успешном разборе, иначе 0
+ */
+static int json_parse_array_parallel (json_parser *parser, json_value *parent)
+{
+    json_split *split = parser->split;
+    json_split_job jobs[JSON_SPLIT_MAX_THREADS];
+    pthread_t workers[JSON_SPLIT_MAX_THREADS];
+    int started[JSON_SPLIT_MAX_THREADS] = { 0 };
+    size_t count = split->count;
+    size_t threads = (size_t)split->threads;
+    int success = 1;
+    size_t i = 0;
+
+    parent->type = TYPE_ARRAY;
+    parent->flags = json_parser_node_flags(parser);
+    json_parser_vector_init(parser, &parent->value.array, 0);
+
+    if (!json_parser_vector_reserve(parser, &parent->value.array, count))
+        return 0;
+
+    json_value *values = (json_value *)parent->value.array.data;
+
+    for (i = 0; i < threads; i++)
+    {
+        json_split_job *job = &jobs[i];
+
+        memset(job, 0, sizeof(*job));
+        job->begin = count * i / threads;
+        job->end = count * (i + 1) / threads;
+        job->next = (i + 1 < threads) ? split->starts[job->end] - 1 : split->close;
+        job->values = values;
+        job->parser = *parser;
+        job->parser.split = NULL;
+        job->parser.structural_pos = split->starts[job->begin];
+        job->parser.cursor = parser->base + parser->structurals[job->parser.structural_pos];
+
+        if (parser->arena != NULL)
+        {
+            size_t span = parser->structurals[job->next] - parser->structurals[job->parser.structural_pos];
+
+            json_arena_init(&job->arena, span);
+            job->allocator = json_arena_allocator(&job->arena);
+            job->parser.allocator = &job->allocator;
+            job->parser.arena = &job->arena;
+        }
+    }
+
+    for (i = 1; i < threads; i++)
+        started[i] = (pthread_create(&workers[i], NULL, json_split_worker, &jobs[i]) == 0);
+
+    json_split_worker(&jobs[0]);
+
+    for (i = 1; i < threads; i++)
+    {
+        if (started[i])
+            pthread_join(workers[i], NULL);
+        else
+            json_split_worker(&jobs[i]);
+    }
+
+    for (i = 0; i < threads; i++)
+    {
+        success = success && jobs[i].success;
+
+        if (parser->arena != NULL)
+            json_arena_adopt(parser->arena, &jobs[i].arena);
+    }
+
+    parent->value.array.size = count;
+
+    if (!success)
+    {
+        // Из кучи освобождаются только разобранные элементы каждой части
+        for (i = 0; i < threads && !json_parser_node_flags(parser); i++)
+        {
+            size_t k = 0;
+
+            for (k = jobs[i].begin; k < jobs[i].begin + jobs[i].parsed; k++)
+                json_free_value_allocator(&values[k], parser->allocator);
+        }
+
+        parent->value.array.size = 0;
+        json_free_value_allocator(parent, parser->allocator);
+
+        return 0;
+    }
+
+    // Продолжение разбора после закрывающей скобки
+    parser->structural_pos = split->close + 1;
+    parser->cursor = parser->base + parser->structurals[split->close] + 1;
+
+    return 1;
+}
+
+
+/*
+ * Функция освобождения объекта JSON-файла, разобранного с выделением памяти распределителем
+ *
+ * Входные данные:
+ *  val       - указатель объект
+ *  allocator - распределитель, использованный при разборе (NULL - куча)
+ */
+void json_free_value_allocator (json_value *val, const json_allocator *allocator)
+{
+    if (!val)
+        return;
+
+    switch (val->type)
+    {
+    case TYPE_STRING:
+    {
+        if (!(val->flags & JSON_FLAG_BORROWED))
+            json_allocator_free(allocator, val->value.string.data);
+
+        val->value.string.data = NULL;
+        break;
+    }
+    case TYPE_ARRAY:
+    case TYPE_OBJECT:
+    {
+        // Контейнер из арены освобождается вместе с ней целиком
+        if (!(val->flags & JSON_FLAG_BORROWED))
+        {
+            json_value *items = (json_value *)val->value.array.data;
+            size_t i = 0;
+
+            for (i = 0; i < val->value.array.size; i++)
+                json_free_value_allocator(&items[i], allocator);
+
+            json_allocator_free(allocator, val->value.array.data);
+            val->value.array.data = NULL;
+        }
+        break;
+    }
+    }
+
+    val->type = TYPE_NULL;
+    val->flags = 0;
+}
+
+
+/*
+ * Функция освобождения объекта JSON-файла
+ *
+ * Входные данные:
+ *  val - указатель объект
+ */
+void json_free_value (json_value *val)
+{
+    json_free_value_allocator(val, NULL);
+}
+
+
+/*
+ * Функция проверки наличия true, false, null в JSON-файле
+ *
+ * Входные данные:
+ *  cursor  - указатель на позицию в массиве с данными JSON файла
+ *  literal - слово для поиска
+ *
+ * Возвращаемое значение:
+ *  1 - при наличии символа, иначе 0
+ */
+int json_is_literal (const char **cursor, const char *literal)
+{
+    size_t cnt = strlen(literal);
+
+    if (strncmp(*cursor, literal, cnt) == 0)
+    {
+        *cursor += cnt;
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Функция чтения четырех шестнадцатеричных цифр escape-последовательности \uXXXX
+ *
+ * Входные данные:
+ *  src - указатель на первую цифру
+ *
+ * Возвращаемое значение:
+ *  код символа либо -1, если последовательность некорректна
+ */
+static long json_parse_hex4 (const char *src)
+{
+    long code = 0;
+    int i = 0;
+
+    for (i = 0; i < 4; i++)
+    {
+        char c = src[i];
+        code <<= 4;
+
+        if (c >= '0' && c <= '9')
+            code |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            code |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            code |= c - 'A' + 10;
+        else
+            return -1;
+    }
+
+    return code;
+}
+
+
+/*
+ * Функция раскрытия escape-последовательностей строки. Результат никогда не длиннее исходной
+ * строки, поэтому dst может совпадать с src (раскрытие на месте)
+ *
+ * Входные данные:
+ *  src     - начало строки (после открывающей кавычки)
+ *  src_end - позиция закрывающей кавычки
+ *  dst     - буфер для результата
+ *
+ * Возвращаемое значение:
+ *  длина результата либо -1, если строка содержит некорректную последовательность
+ */
+static long json_unescape_string (const char *src, const char *src_end, char *dst)
+{
+    char *out = dst;
+
+    while (src < src_end)
+    {
+        if (*src != '\\')
+        {
+            *out++ = *src++;
+            continue;
+        }
+
+        ++src;
+
+        switch (*src++)
+        {
+        case '"':  *out++ = '"';  break;
+        case '\\': *out++ = '\\'; break;
+        case '/':  *out++ = '/';  break;
+        case 'b':  *out++ = '\b'; break;
+        case 'f':  *out++ = '\f'; break;
+        case 'n':  *out++ = '\n'; break;
+        case 'r':  *out++ = '\r'; break;
+        case 't':  *out++ = '\t'; break;
+        case 'u':
+        {
+            if (src_end - src < 4)
+                return -1;
+
+            long code = json_parse_hex4(src);
+
+            if (code < 0)
+                return -1;
+
+            src += 4;
+
+            // Суррогатная пара UTF-16
+            if (code >= 0xD800 && code <= 0xDBFF)
+            {
+                if (src_end - src < 6 || src[0] != '\\' || src[1] != 'u')
+                    return -1;
+
+                long low = json_parse_hex4(src + 2);
+
+                if (low < 0xDC00 || low > 0xDFFF)
+                    return -1;
+
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                src += 6;
+            }
+            else if (code >= 0xDC00 && code <= 0xDFFF)
+            {
+                return -1;
+            }
+
+            if (code < 0x80)
+            {
+                *out++ = (char)code;
+            }
+            else if (code < 0x800)
+            {
+                *out++ = (char)(0xC0 | (code >> 6));
+                *out++ = (char)(0x80 | (code & 0x3F));
+            }
+            else if (code < 0x10000)
+            {
+                *out++ = (char)(0xE0 | (code >> 12));
+                *out++ = (char)(0x80 | ((code >> 6) & 0x3F));
+                *out++ = (char)(0x80 | (code & 0x3F));
+            }
+            else
+            {
+                *out++ = (char)(0xF0 | (code >> 18));
+                *out++ = (char)(0x80 | ((code >> 12) & 0x3F));
+                *out++ = (char)(0x80 | ((code >> 6) & 0x3F));
+                *out++ = (char)(0x80 | (code & 0x3F));
+            }
+
+            break;
+        }
+        default:
+            return -1;
+        }
+    }
+
+    return (long)(out - dst);
+}
+
+
+/*
+ * Функция разбора строки. В режиме JSON_PARSE_IN_SITU узел ссылается на входной буфер,
+ * который изменяется только при наличии escape-последовательностей; иначе строка копируется в кучу
+ *
+ * Входные данные:
+ *  parser - состояние разбора (курсор указывает на открывающую кавычку)
+ *  parent - родительский объект
+ *
+ * Возвращаемое значение:
+ *  1 - при успешном разборе, иначе 0
+ */
+static int json_parse_string (json_parser *parser, json_value *parent)
+{
+    const char *start = parser->cursor + 1;
+    const char *end = start;
+    int escaped = 0;
+
+    if (parser->structurals != NULL)
+    {
+        // Закрывающая кавычка - следующий элемент структурного индекса
+        end = parser->base + parser->structurals[parser->structural_pos];
+
+        if (*end != '"')
+            return 0;
+
+        parser->structural_pos++;
+        escaped = (memchr(start, '\\', (size_t)(end - start)) != NULL);
+    }
+    else
+    {
+        // Поиск закрывающей кавычки с учетом экранирования
+        while (*end != '"')
+        {
+            if (*end == '\0')
+                return 0;
+
+            if (*end == '\\')
+            {
+                escaped = 1;
+
+                if (*++end == '\0')
+                    return 0;
+            }
+
+            ++end;
+        }
+    }
+
+    long length = (long)(end - start);
+    char *string = NULL;
+
+    if (parser->flags & JSON_PARSE_IN_SITU)
+    {
+        string = (char *)start;
+
+        if (escaped)
+            length = json_unescape_string(start, end, string);
+
+        if (length < 0)
+            return 0;
+
+        parent->flags = JSON_FLAG_BORROWED;
+    }
+    else
+    {
+        string = json_parser_alloc(parser, (size_t)length + 1);
+
+        if (string == NULL)
+            return 0;
+
+        if (escaped)
+            length = json_unescape_string(start, end, string);
+        else
+            memcpy(string, start, (size_t)length);
+
+        if (length < 0)
+        {
+            json_parser_free(parser, string);
+            return 0;
+        }
+
+        string[length] = '\0';
+        parent->flags = json_parser_node_flags(parser);
+    }
+
+    parent->type = TYPE_STRING;
+    parent->value.string.data = string;
+    parent->value.string.length = (size_t)length;
+    parser->cursor = end + 1;
+
+    return 1;
+}
+
+
+/*
+ * Функция разбора числа. Целые числа, помещающиеся в int64_t, разбираются без strtod
+ * в узел TYPE_INTEGER. Для дробных чисел с мантиссой до 2^53 и десятичным порядком
+ * до 22 результат вычисляется точно одним умножением или делением, остальные
+ * (редкие) случаи передаются strtod для корректного округления
+ *
+ * Входные данные:
+ *  parser - состояние разбора (курсор указывает на первый символ числа)
+ *  parent - родительский объект
+ *
+ * Возвращаемое значение:
+ *  1 - при успешном разборе, иначе 0
+ */
+static int json_parse_number (json_parser *parser, json_value *parent)
+{
+    static const double powers_of_ten[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char *start = parser->cursor;
+    const char *p = start;
+    int negative = 0;
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int truncated = 0;
+    long exponent = 0;
+
+    if (*p == '-')
+    {
+        negative = 1;
+        ++p;
+    }
+
+    if (*p == '0')
+    {
+        ++p;
+        digits = 1;
+    }
+    else
+    {
+        while (*p >= '0' && *p <= '9')
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            }
+            else
+            {
+                exponent++;
+                truncated = 1;
+            }
+
+            ++p;
+            ++digits;
+        }
+    }
+
+    if (digits == 0)
+        return 0;
+
+    if (*p != '.' && *p != 'e' && *p != 'E')
+    {
+        if (!json_is_value_end(*p))
+            return 0;
+
+        // Целое число: точное значение, если оно помещается в int64_t
+        if (!truncated && (mantissa <= (uint64_t)INT64_MAX || (negative && mantissa == (uint64_t)INT64_MAX + 1)))
+        {
+            parent->type = TYPE_INTEGER;
+            parent->value.integer = negative ? (int64_t)(0 - mantissa) : (int64_t)mantissa;
+            parser->cursor = p;
+
+            return 1;
+        }
+    }
+    else
+    {
+        if (*p == '.')
+        {
+            const char *fraction = ++p;
+
+            while (*p >= '0' && *p <= '9')
+            {
+                if (digits < 19)
+                {
+                    mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                    exponent--;
+
+                    // Ведущие нули не занимают значащих разрядов
+                    if (mantissa != 0)
+                        digits++;
+                }
+                else
+                {
+                    truncated = 1;
+                }
+
+                ++p;
+            }
+
+            if (p == fraction)
+                return 0;
+        }
+
+        if (*p == 'e' || *p == 'E')
+        {
+            int exponent_negative = 0;
+            long exponent_value = 0;
+
+            ++p;
+
+            if (*p == '+' || *p == '-')
+                exponent_negative = (*p++ == '-');
+
+            if (!(*p >= '0' && *p <= '9'))
+                return 0;
+
+            while (*p >= '0' && *p <= '9')
+            {
+                if (exponent_value < 100000)
+                    exponent_value = exponent_value * 10 + (*p - '0');
+
+                ++p;
+            }
+
+            exponent += exponent_negative ? -exponent_value : exponent_value;
+        }
+
+        if (!json_is_value_end(*p))
+            return 0;
+
+        if (!truncated && mantissa <= ((uint64_t)1 << 53) && exponent >= -22 && exponent <= 22)
+        {
+            double number = (double)mantissa;
+
+            number = (exponent < 0) ? number / powers_of_ten[-exponent] : number * powers_of_ten[exponent];
+
+            parent->type = TYPE_NUMBER;
+            parent->value.number = negative ? -number : number;
+            parser->cursor = p;
+
+            return 1;
+        }
+    }
+
+    // Медленный путь: большие целые, длинные мантиссы и большие порядки
+    char *end;
+    double number = strtod(start, &end);
+
+    if (end != p)
+        return 0;
+
+    parent->type = TYPE_NUMBER;
+    parent->value.number = number;
+    parser->cursor = p;
+
+    return 1;
+}
+
+
+/*
+ * Функция парсинга JSON файла
+ *
+ * Входные данные:
+ *  parser - состояние разбора
+ *  parent - родительский объект
+ *
+ * Возвращаемое значение:
+ *  положительное значение при наличии символа, иначе 0
+ */
+int json_parse_value (json_parser *parser, json_value *parent)
+{
+    // Eat whitespace
+    int success = 0;
+    const char **cursor = &parser->cursor;
+    json_parser_skip_whitespace(parser);
+
+    // Начало значения занимает один элемент структурного индекса
+    if (parser->structurals != NULL)
+        parser->structural_pos++;
+
+    switch (**cursor)
+    {
+    case '\0':
+    {
+        // If parse_value is called with the cursor at the end of the string
+        // that's a failure
+        success = 0;
+
+        break;
+    }
+
+    case '"':
+    {
+        success = json_parse_string(parser, parent);
+
+        break;
+    }
+
+    case '{':
+    {
+        ++(*cursor);
+        success = json_parse_object(parser, parent);
+
+        break;
+    }
+
+    case '[':
+    {
+        // Массив, выбранный для параллельного разбора
+        if (parser->split != NULL && parser->structural_pos - 1 == parser->split->open)
+        {
+            ++(*cursor);
+            success = json_parse_array_parallel(parser, parent);
+
+            break;
+        }
+
+        parent->type = TYPE_ARRAY;
+        parent->flags = json_parser_node_flags(parser);
+        ++(*cursor);
+        json_parser_vector_init(parser, &parent->value.array, json_prescan_count(parser));
+        success = json_parse_array(parser, parent);
+
+        if (!success)
+        {
+            json_free_value_allocator(parent, parser->allocator);
+        }
+
+        break;
+    }
+
+    case 't':
+    {
+        success = json_is_literal(cursor, "true") && json_is_value_end(**cursor);
+
+        if (success)
+        {
+            parent->type = TYPE_BOOL;
+            parent->value.boolean = 1;
+        }
+
+        break;
+    }
+
+    case 'f':
+    {
+        success = json_is_literal(cursor, "false") && json_is_value_end(**cursor);
+
+        if (success)
+        {
+            parent->type = TYPE_BOOL;
+            parent->value.boolean = 0;
+        }
+
+        break;
+    }
+
+    case 'n':
+    {
+        success = json_is_literal(cursor, "null") && json_is_value_end(**cursor);
+        break;
+    }
+
+    default:
+    {
+        success = json_parse_number(parser, parent);
+    }
+    }
+
+    return success;
+}
+
+
+/*
+ * Функция конвертации объекта в строку. Строка, разобранная на месте, при первом обращении
+ * завершается нулем прямо во входном буфере (на месте закрывающей кавычки)
+ *
+ * Входные данные:
+ *  value - объект
+ *
+ * Возвращаемое значение:
+ *  конвертированная строка
+ */
+char *json_value_to_string (json_value *value)
+{
+    if (value->type != TYPE_STRING)
+        return NULL;
+
+    value->value.string.data[value->value.string.length] = '\0';
+
+    return value->value.string.data;
+}
+
+
+/*
+ * Функция получения строки объекта без завершающего нуля
+ *
+ * Входные данные:
+ *  value  - объект
+ *  length - длина строки (выходной параметр)
+ *
+ * Возвращаемое значение:
+ *  указатель на начало строки либо NULL
+ */
+const char *json_value_to_string_view (const json_value *value, size_t *length)
+{
+    if (value->type != TYPE_STRING)
+    {
+        *length = 0;
+        return NULL;
+    }
+
+    *length = value->value.string.length;
+
+    return value->value.string.data;
+}
+
+
+/*
+ * Функция сравнения строкового объекта со строкой
+ *
+ * Входные данные:
+ *  value - объект
+ *  str   - строка для сравнения
+ *
+ * Возвращаемое значение:
+ *  1 - объект является строкой, равной str, иначе 0
+ */
+int json_value_is_string (const json_value *value, const char *str)
+{
+    if (value->type != TYPE_STRING)
+        return 0;
+
+    size_t length = strlen(str);
+
+    return (value->value.string.length == length) && (memcmp(value->value.string.data, str, length) == 0);
+}
+
+
+/*
+ * Функция конвертации объекта в числовое значение
+ *
+ * Входные данные:
+ *  value - объект
+ *
+ * Возвращаемое значение:
+ *  числовое значение
+ */
+double json_value_to_double (json_value *value)
+{
+    if (value->type == TYPE_INTEGER)
+        return (double)value->value.integer;
+
+    if (value->type != TYPE_NUMBER)
+        return 0;
+
+    return value->value.number;
+}
+
+
+/*
+ * Функция конвертации объекта в целое значение. Дробная часть отбрасывается
+ *
+ * Входные данные:
+ *  value - объект
+ *
+ * Возвращаемое значение:
+ *  целое значение
+ */
+int64_t json_value_to_int64 (const json_value *value)
+{
+    if (value->type == TYPE_INTEGER)
+        return value->value.integer;
+
+    if (value->type == TYPE_NUMBER && value->value.number >= -9223372036854775808.0 && value->value.number < 9223372036854775808.0)
+        return (int64_t)value->value.number;
+
+    return 0;
+}
+
+
+/*
+ * Функция конвертации объекта в 32-битное беззнаковое значение с проверкой диапазона
+ *
+ * Входные данные:
+ *  value  - объект
+ *  result - значение (выходной параметр, изменяется только при успехе)
+ *
+ * Возвращаемое значение:
+ *  1 - объект является целым числом от 0 до UINT32_MAX, иначе 0
+ */
+int json_value_to_uint32 (const json_value *value, uint32_t *result)
+{
+    int64_t integer = 0;
+
+    if (value->type == TYPE_INTEGER)
+    {
+        integer = value->value.integer;
+    }
+    else if (value->type == TYPE_NUMBER && value->value.number >= 0 && value->value.number <= UINT32_MAX &&
+             value->value.number == (double)(uint32_t)value->value.number)
+    {
+        integer = (int64_t)value->value.number;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (integer < 0 || integer > UINT32_MAX)
+        return 0;
+
+    *result = (uint32_t)integer;
+
+    return 1;
+}
+
+
+/*
+ * Функция конвертации объекта в булевое значение
+ *
+ * Входные данные:
+ *  value - объект
+ *
+ * Возвращаемое значение:
+ *  булевое значение
+ */
+int json_value_to_bool (json_value *value)
+{
+    if (value->type != TYPE_BOOL)
+        return 0;
+
+    return value->value.boolean;
+}
+
+
+/*
+ * Функция конвертации объекта в вектор
+ *
+ * Входные данные:
+ *  value - объект
+ *
+ * Возвращаемое значение:
+ *  указатель на вектор
+ */
+vector *json_value_to_array (json_value *value)
+{
+    if (value->type != TYPE_ARRAY)
+        return NULL;
+
+    return &value->value.array;
+}
+
+
+/*
+ * Функция конвертации объекта в объектный тип
+ *
+ * Входные данные:
+ *  value - объект
+ *
+ * Возвращаемое значение:
+ *  указатель на вектор объектного типа
+ */
+vector *json_value_to_object (json_value *value)
+{
+    if (value->type != TYPE_OBJECT)
+        return NULL;
+
+    return &value->value.object;
+}
+
+
+/*
+ * Функция получения узла по индексу
+ *
+ * Входные данные:
+ *  root  - объект
+ *  index - индекс в массиве
+ *
+ * Возвращаемое значение:
+ *  указатель на узел
+ */
+json_value *json_value_at (const json_value *root, size_t index)
+{
+    if (root->type != TYPE_ARRAY)
+        return NULL;
+
+    if (root->value.array.size >= index)
+    {
+        return vector_get_checked(&root->value.array,index);
+    }
+    else
+    {
+        return NULL;
+    }
+}
+
+
+/*
+ * Функция поиска значения объекта по ключу с известным хешем
+ * Входные данные:
+ *  root       - объект
+ *  key        - ключ
+ *  key_length - длина ключа
+ *  hash       - хеш ключа (json_hash_string)
+ *
+ * Возвращаемое значение:
+ *  указатель на узел либо NULL
+ */
+static json_value *json_object_find (const json_value *root, const char *key, size_t key_length, uint32_t hash)
+{
+    if (root->type != TYPE_OBJECT)
+        return NULL;
+
+    json_value* data = (json_value*)root->value.object.data;
+    size_t size = root->value.object.size;
+    size_t i = 0;
+
+    if (root->flags & JSON_FLAG_INDEXED)
+    {
+        size_t mask = json_object_index_slots(size / 2) - 1;
+        const uint32_t *slots = (const uint32_t *)(data + size);
+        size_t slot = hash & mask;
+
+        while (slots[slot] != 0)
+        {
+            json_value *item = &data[slots[slot] - 1];
+
+            if (item->value.string.hash == hash && item->value.string.length == key_length &&
+                memcmp(item->value.string.data, key, key_length) == 0)
+            {
+                return item + 1;
+            }
+
+            slot = (slot + 1) & mask;
+        }
+
+        return NULL;
+    }
+
+    for (i = 0; i < size; i += 2)
+    {
+        if (data[i].value.string.hash == hash && data[i].value.string.length == key_length &&
+            memcmp(data[i].value.string.data, key, key_length) == 0)
+        {
+            return &data[i + 1];
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Функция получения узла по ключу
+ * Входные данные:
+ *  root - объект
+ *  key  - ключ
+ *
+ * Возвращаемое значение:
+ *  указатель на узел
+ */
+json_value *json_value_with_key (const json_value *root, const char *key)
+{
+    size_t key_length = strlen(key);
+
+    return json_object_find(root, key, key_length, json_hash_string(key, key_length));
+}
+
+
+/*
+ * Функция компиляции указателя JSON (RFC 6901), например "/REGULAR_CONFIG/17/dst_id".
+ * Ключи шагов раскрываются (~1 - '/', ~0 - '~') и хешируются один раз, шаги, являющиеся
+ * индексами массива, переводятся в число. Пустая строка указывает на весь документ
+ *
+ * Входные данные:
+ *  pointer - указатель JSON
+ *  path    - скомпилированный указатель (выходной параметр, освобождается json_pointer_free)
+ *
+ * Возвращаемое значение:
+ *  SUCCESS, DEF_ERROR при неверном указателе, -ENOMEM при ошибке выделения памяти
+ */
+int json_pointer_compile (const char *pointer, json_pointer *path)
+{
+    size_t length = strlen(pointer);
+    size_t count = 0;
+    size_t i = 0;
+
+    path->steps = NULL;
+    path->count = 0;
+
+    if (length == 0)
+        return SUCCESS;
+
+    if (pointer[0] != '/')
+        return DEF_ERROR;
+
+    for (i = 0; i < length; i++)
+        count += (pointer[i] == '/');
+
+    // Шаги и раскрытые ключи размещаются одним блоком
+    json_pointer_step *steps = malloc(count * sizeof(json_pointer_step) + length + count);
+
+    if (steps == NULL)
+        return -ENOMEM;
+
+    char *keys = (char *)(steps + count);
+    const char *src = pointer + 1;
+    size_t n = 0;
+
+    for (n = 0; n < count; n++)
+    {
+        json_pointer_step *step = &steps[n];
+        char *dst = keys;
+
+        while (*src != '\0' && *src != '/')
+        {
+            if (*src == '~')
+            {
+                if (src[1] != '0' && src[1] != '1')
+                {
+                    free(steps);
+                    return DEF_ERROR;
+                }
+
+                *dst++ = (src[1] == '0') ? '~' : '/';
+                src += 2;
+            }
+            else
+            {
+                *dst++ = *src++;
+            }
+        }
+
+        *dst = '\0';
+        step->key = keys;
+        step->length = (size_t)(dst - keys);
+        step->hash = json_hash_string(step->key, step->length);
+
+        // Индекс массива: "0" либо число без ведущих нулей
+        step->is_index = (step->length > 0 && step->length <= 18 && (step->key[0] != '0' || step->length == 1));
+        step->index = 0;
+
+        for (i = 0; step->is_index && i < step->length; i++)
+        {
+            if (step->key[i] < '0' || step->key[i] > '9')
+                step->is_index = 0;
+            else
+                step->index = step->index * 10 + (size_t)(step->key[i] - '0');
+        }
+
+        keys = dst + 1;
+        src++;
+    }
+
+    path->steps = steps;
+    path->count = count;
+
+    return SUCCESS;
+}
+
+
+/*
+ * Функция вычисления скомпилированного указателя JSON: в объектах значение ищется по хешу
+ * ключа, в массивах берется по индексу
+ *
+ * Входные данные:
+ *  path - скомпилированный указатель
+ *  root - корневой узел документа
+ *
+ * Возвращаемое значение:
+ *  указатель на узел либо NULL, если узла нет
+ */
+json_value *json_pointer_eval (const json_pointer *path, const json_value *root)
+{
+    const json_value *node = root;
+    size_t i = 0;
+
+    for (i = 0; node != NULL && i < path->count; i++)
+    {
+        const json_pointer_step *step = &path->steps[i];
+
+        if (node->type == TYPE_OBJECT)
+        {
+            node = json_object_find(node, step->key, step->length, step->hash);
+        }
+        else if (node->type == TYPE_ARRAY && step->is_index && step->index < node->value.array.size)
+        {
+            node = (const json_value *)vector_get(&node->value.array, step->index);
+        }
+        else
+        {
+            node = NULL;
+        }
+    }
+
+    return (json_value *)node;
+}
+
+
+/*
+ * Функция освобождения скомпилированного указателя JSON
+ *
+ * Входные данные:
+ *  path - скомпилированный указатель
+ */
+void json_pointer_free (json_pointer *path)
+{
+    free(path->steps);
+    path->steps = NULL;
+    path->count = 0;
+}
+
+
+/*
+ * Функция выполнения разбора: построение структурного индекса (первый проход)
+ * и разбор корневого значения по нему (второй проход)
+ *
+ * Входные данные:
+ *  parser - состояние разбора
+ *  result - объект распарсенного JSON-файла
+ *
+ * Возвращаемое значение:
+ *  положительное значение при наличии символа, иначе 0
+ */
+static int json_parser_run (json_parser *parser, json_value *result)
+{
+    json_build_structural_index(parser, parser->cursor, strlen(parser->cursor));
+
+    int success = json_parse_value(parser, result);
+
+    json_release_structural_index(parser);
+
+    return success;
+}
+
+
+/*
+ * Функция парсинга JSON-файла (первый этап)
+ * Входные данные:
+ *  input  - указатель на массив с данными JSON файла
+ *  result - объект распарсенного JSON-файла
+ *
+ * Возвращаемое значение:
+ *  положительное значение при наличии символа, иначе 0
+ */
+int json_parse (const char *input, json_value *result)
+{
+    json_parser parser = { .cursor = input, .flags = 0, .allocator = NULL };
+
+    return json_parser_run(&parser, result);
+}
+
+
+/*
+ * Функция парсинга JSON-файла без копирования строк. Строки и ключи ссылаются на input,
+ * который должен существовать, пока используется дерево, и изменяется при раскрытии escape-последовательностей
+ * Входные данные:
+ *  input  - указатель на изменяемый массив с данными JSON файла
+ *  result - объект распарсенного JSON-файла
+ *
+ * Возвращаемое значение:
+ *  положительное значение при наличии символа, иначе 0
+ */
+int json_parse_in_situ (char *input, json_value *result)
+{
+    json_parser parser = { .cursor = input, .flags = JSON_PARSE_IN_SITU, .allocator = NULL };
+
+    return json_parser_run(&parser, result);
+}
+
+
+/*
+ * Функция парсинга JSON-файла с выделением памяти под узлы, векторы, строки и структурный
+ * индекс заданным распределителем (пулы, huge pages, учет памяти документа). Дерево освобождается
+ * json_free_value_allocator с тем же распределителем, а при allocator->free == NULL - его владельцем
+ * Входные данные:
+ *  input     - указатель на массив с данными JSON файла (изменяемый при JSON_PARSE_IN_SITU)
+ *  result    - объект распарсенного JSON-файла
+ *  allocator - распределитель (NULL - куча)
+ *  flags     - режимы разбора JSON_PARSE_*
+ *
+ * Возвращаемое значение:
+ *  положительное значение при наличии символа, иначе 0
+ */
+int json_parse_allocator (const char *input, json_value *result, const json_allocator *allocator, int flags)
+{
+    json_parser parser = { .cursor = input, .flags = flags, .allocator = allocator };
+
+    return json_parser_run(&parser, result);
+}
+
+
+/*
+ * Функция парсинга JSON-файла с размещением всех узлов, векторов и строк в арене.
+ * Дерево освобождается вызовом json_arena_release или json_arena_reset за O(1) от числа узлов,
+ * json_free_value для него ничего не делает
+ * Входные данные:
+ *  input  - указатель на массив с данными JSON файла (изменяемый при JSON_PARSE_IN_SITU)
+ *  result - объект распарсенного JSON-файла
+ *  arena  - арена
+ *  flags  - режимы разбора JSON_PARSE_*
+ *
+ * Возвращаемое значение:
+ *  положительное значение при наличии символа, иначе 0
+ */
+int json_parse_arena (const char *input, json_value *result, json_arena *arena, int flags)
+{
+    json_allocator allocator = json_arena_allocator(arena);
+    json_parser parser = { .cursor = input, .flags = flags, .arena = arena };
+
+    parser.allocator = (arena != NULL) ? &allocator : NULL;
+
+    return json_parser_run(&parser, result);
+}
+
+
+/*
+ * Функция парсинга JSON-файла в арену с параллельным разбором наибольшего массива верхних
+ * уровней (например, REGULAR_CONFIG). Результат совпадает с json_parse_arena. Если массив
+ * мал или структурный индекс не построен, разбор идет в одном потоке
+ * Входные данные:
+ *  input   - указатель на массив с данными JSON файла (изменяемый при JSON_PARSE_IN_SITU)
+ *  result  - объект распарсенного JSON-файла
+ *  arena   - арена
+ *  flags   - режимы разбора JSON_PARSE_*
+ *  threads - число потоков
+ *
+ * Возвращаемое значение:
+ *  положительное значение при наличии символа, иначе 0
+ */
+int json_parse_arena_parallel (const char *input, json_value *result, json_arena *arena, int flags, int threads)
+{
+    json_allocator allocator = json_arena_allocator(arena);
+    json_parser parser = { .cursor = input, .flags = flags, .arena = arena };
+
+    parser.allocator = (arena != NULL) ? &allocator : NULL;
+    json_split split;
+
+    json_build_structural_index(&parser, parser.cursor, strlen(parser.cursor));
+
+    if (json_find_split(&parser, &split, threads))
+        parser.split = &split;
+
+    int success = json_parse_value(&parser, result);
+
+    json_allocator_free(json_parser_temp_allocator(&parser), split.starts);
+    json_release_structural_index(&parser);
+
+    return success;
+}
+
+
+/*
+ * Функция открытия документа для разбора по требованию. Значения не разбираются до обращения,
+ * пропускаемые значения не проверяются на корректность
+ * Входные данные:
+ *  doc     - документ (выходной параметр, освобождается json_lazy_close)
+ *  input   - данные JSON файла, должны существовать, пока используется документ
+ *  scratch - буферы разбора (NULL - выделяются для документа)
+ *
+ * Возвращаемое значение:
+ *  SUCCESS либо DEF_ERROR, если структурный индекс не построен
+ */
+int json_lazy_open (json_lazy_doc *doc, const char *input, json_scratch *scratch)
+{
+    memset(&doc->parser, 0, sizeof(doc->parser));
+    doc->parser.cursor = input;
+    doc->parser.scratch = scratch;
+
+    return json_build_structural_index(&doc->parser, input, strlen(input)) ? SUCCESS : DEF_ERROR;
+}
+
+
+/*
+ * Функция закрытия документа для разбора по требованию
+ *
+ * Входные данные:
+ *  doc - документ
+ */
+void json_lazy_close (json_lazy_doc *doc)
+{
+    json_release_structural_index(&doc->parser);
+}
+
+
+/*
+ * Функция получения корневого значения документа
+ *
+ * Входные данные:
+ *  doc - документ
+ *
+ * Возвращаемое значение:
+ *  корневое значение
+ */
+json_lazy json_lazy_root (const json_lazy_doc *doc)
+{
+    json_lazy root = { doc, 0 };
+
+    return root;
+}
+
+
+/*
+ * Функция получения первого символа элемента структурного индекса
+ *
+ * Входные данные:
+ *  parser - состояние разбора с индексом
+ *  pos    - элемент индекса
+ *
+ * Возвращаемое значение:
+ *  символ либо нуль за пределами индекса
+ */
+static inline char json_lazy_char (const json_parser *parser, size_t pos)
+{
+    return (pos < parser->structural_count) ? parser->base[parser->structurals[pos]] : '\0';
+}
+
+
+/*
+ * Функция получения типа значения по его первому символу (без разбора)
+ *
+ * Входные данные:
+ *  value - значение
+ *
+ * Возвращаемое значение:
+ *  TYPE_* (TYPE_NUMBER для любого числа), -1 - значение некорректно
+ */
+int json_lazy_type (const json_lazy *value)
+{
+    switch (json_lazy_char(&value->doc->parser, value->pos))
+    {
+    case '{':
+        return TYPE_OBJECT;
+    case '[':
+        return TYPE_ARRAY;
+    case '"':
+        return TYPE_STRING;
+    case 't':
+    case 'f':
+        return TYPE_BOOL;
+    case 'n':
+        return TYPE_NULL;
+    case '-':
+    case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+        return TYPE_NUMBER;
+    default:
+        return -1;
+    }
+}
+
+
+/*
+ * Функция пропуска значения по структурному индексу: строка занимает два элемента (кавычки),
+ * контейнер пропускается подсчетом скобок до парной закрывающей
+ *
+ * Входные данные:
+ *  parser - состояние разбора с индексом
+ *  pos    - элемент индекса, с которого начинается значение
+ *
+ * Возвращаемое значение:
+ *  элемент индекса, следующий за значением
+ */
+static size_t json_lazy_skip (const json_parser *parser, size_t pos)
+{
+    size_t depth = 0;
+    char c = json_lazy_char(parser, pos);
+
+    if (c == '"')
+        return (pos + 2 < parser->structural_count) ? pos + 2 : parser->structural_count;
+
+    if (c != '{' && c != '[')
+        return pos + 1;
+
+    for (; pos < parser->structural_count; pos++)
+    {
+        c = parser->base[parser->structurals[pos]];
+
+        if (c == '{' || c == '[')
+            depth++;
+        else if ((c == '}' || c == ']') && --depth == 0)
+            return pos + 1;
+    }
+
+    return parser->structural_count;
+}
+
+
+/*
+ * Функция сравнения ключа объекта (без раскрытия, если в нем нет escape-последовательностей)
+ *
+ * Входные данные:
+ *  parser     - состояние разбора с индексом
+ *  pos        - элемент индекса открывающей кавычки ключа
+ *  key        - искомый ключ
+ *  key_length - длина искомого ключа
+ *
+ * Возвращаемое значение:
+ *  1 - ключи равны, иначе 0
+ */
+static int json_lazy_key_equals (const json_parser *parser, size_t pos, const char *key, size_t key_length)
+{
+    const char *start = parser->base + parser->structurals[pos] + 1;
+    const char *end = parser->base + parser->structurals[pos + 1];
+    size_t length = (size_t)(end - start);
+
+    // Раскрытая строка не длиннее исходной
+    if (length < key_length)
+        return 0;
+
+    if (memchr(start, '\\', length) == NULL)
+        return length == key_length && memcmp(start, key, key_length) == 0;
+
+    char local[256];
+    char *buffer = (length <= sizeof(local)) ? local : malloc(length);
+
+    if (buffer == NULL)
+        return 0;
+
+    long unescaped = json_unescape_string(start, end, buffer);
+    int equal = (unescaped == (long)key_length && memcmp(buffer, key, key_length) == 0);
+
+    if (buffer != local)
+        free(buffer);
+
+    return equal;
+}
+
+
+/*
+ * Функция поиска значения объекта по ключу. Значения пропущенных пар не разбираются
+ *
+ * Входные данные:
+ *  object     - объект
+ *  key        - ключ
+ *  key_length - длина ключа
+ *  result     - значение (выходной параметр)
+ *
+ * Возвращаемое значение:
+ *  1 - значение найдено, иначе 0
+ */
+static int json_lazy_find (const json_lazy *object, const char *key, size_t key_length, json_lazy *result)
+{
+    const json_parser *parser = &object->doc->parser;
+    size_t pos = object->pos + 1;
+
+    if (json_lazy_char(parser, object->pos) != '{' || json_lazy_char(parser, pos) == '}')
+        return 0;
+
+    // Пара: открывающая и закрывающая кавычки ключа, ':', значение, затем ',' либо '}'
+    while (json_lazy_char(parser, pos) == '"' && json_lazy_char(parser, pos + 2) == ':')
+    {
+        if (json_lazy_key_equals(parser, pos, key, key_length))
+        {
+            result->doc = object->doc;
+            result->pos = pos + 3;
+            return 1;
+        }
+
+        pos = json_lazy_skip(parser, pos + 3);
+
+        if (json_lazy_char(parser, pos) != ',')
+            break;
+
+        pos++;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Функция получения значения объекта по ключу
+ *
+ * Входные данные:
+ *  object - объект
+ *  key    - ключ
+ *  result - значение (выходной параметр)
+ *
+ * Возвращаемое значение:
+ *  1 - значение найдено, иначе 0
+ */
+int json_lazy_with_key (const json_lazy *object, const char *key, json_lazy *result)
+{
+    return json_lazy_find(object, key, strlen(key), result);
+}
+
+
+/*
+ * Функция получения элемента массива по индексу. Предшествующие элементы пропускаются
+ * без разбора
+ *
+ * Входные данные:
+ *  array  - массив
+ *  index  - индекс в массиве
+ *  result - элемент (выходной параметр)
+ *
+ * Возвращаемое значение:
+ *  1 - элемент найден, иначе 0
+ */
+int json_lazy_at (const json_lazy *array, size_t index, json_lazy *result)
+{
+    const json_parser *parser = &array->doc->parser;
+    size_t pos = array->pos + 1;
+
+    if (json_lazy_char(parser, array->pos) != '[' || json_lazy_char(parser, pos) == ']')
+        return 0;
+
+    while (index > 0)
+    {
+        pos = json_lazy_skip(parser, pos);
+
+        if (json_lazy_char(parser, pos) != ',')
+            return 0;
+
+        pos++;
+        index--;
+    }
+
+    result->doc = array->doc;
+    result->pos = pos;
+
+    return json_lazy_type(result) >= 0;
+}
+
+
+/*
+ * Функция вычисления скомпилированного указателя JSON без разбора документа
+ *
+ * Входные данные:
+ *  root   - значение, от которого отсчитывается указатель
+ *  path   - скомпилированный указатель
+ *  result - значение (выходной параметр)
+ *
+ * Возвращаемое значение:
+ *  1 - значение найдено, иначе 0
+ */
+int json_lazy_pointer (const json_lazy *root, const json_pointer *path, json_lazy *result)
+{
+    json_lazy node = *root;
+    size_t i = 0;
+
+    for (i = 0; i < path->count; i++)
+    {
+        const json_pointer_step *step = &path->steps[i];
+        int found = 0;
+
+        if (json_lazy_char(&node.doc->parser, node.pos) == '{')
+            found = json_lazy_find(&node, step->key, step->length, &node);
+        else if (step->is_index)
+            found = json_lazy_at(&node, step->index, &node);
+
+        if (!found)
+            return 0;
+    }
+
+    *result = node;
+
+    return 1;
+}
+
+
+/*
+ * Функция разбора значения (со всеми вложенными) в обычный узел. Строки копируются,
+ * входные данные не изменяются, поэтому значение можно разбирать повторно
+ *
+ * Входные данные:
+ *  value  - значение
+ *  result - узел (выходной параметр)
+ *  arena  - арена для узлов и строк (NULL - выделение из кучи, освобождается json_free_value)
+ *
+ * Возвращаемое значение:
+ *  1 - при успешном разборе, иначе 0
+ */
+int json_lazy_value (const json_lazy *value, json_value *result, json_arena *arena)
+{
+    json_parser parser = value->doc->parser;
+    json_allocator allocator;
+
+    if (value->pos >= parser.structural_count)
+        return 0;
+
+    if (arena != NULL)
+        allocator = json_arena_allocator(arena);
+
+    parser.flags = 0;
+    parser.allocator = (arena != NULL) ? &allocator : NULL;
+    parser.arena = arena;
+    parser.split = NULL;
+    parser.structural_pos = value->pos;
+    parser.cursor = parser.base + parser.structurals[value->pos];
+    result->type = TYPE_NULL;
+    result->flags = 0;
+
+    return json_parse_value(&parser, result);
+}
+
+
+/*
+ * Функция потокового разбора значения: вместо построения узлов вызываются обработчики событий
+ *
+ * Входные данные:
+ *  parser - состояние разбора (parser->sax задан)
+ *
+ * Возвращаемое значение:
+ *  1 - при успешном разборе, иначе 0
+ */
+static int json_sax_parse_value (json_parser *parser)
+{
+    const json_sax_handler *handler = parser->sax;
+    void *context = parser->sax_context;
+    const char **cursor = &parser->cursor;
+    json_value scalar = { .type = TYPE_NULL };
+    int success = 0;
+
+    json_parser_skip_whitespace(parser);
+
+    // Начало значения занимает один элемент структурного индекса
+    if (parser->structurals != NULL)
+        parser->structural_pos++;
+
+    switch (**cursor)
+    {
+    case '\0':
+    {
+        success = 0;
+
+        break;
+    }
+
+    case '"':
+    {
+        success = json_parse_string(parser, &scalar);
+        success = success && (handler->on_string == NULL ||
+                              handler->on_string(context, scalar.value.string.data, scalar.value.string.length));
+
+        break;
+    }
+
+    case '{':
+    {
+        ++(*cursor);
+        success = json_sax_parse_object(parser);
+
+        break;
+    }
+
+    case '[':
+    {
+        ++(*cursor);
+        success = json_sax_parse_array(parser);
+
+        break;
+    }
+
+    case 't':
+    case 'f':
+    {
+        int value = (**cursor == 't');
+
+        success = json_is_literal(cursor, value ? "true" : "false") && json_is_value_end(**cursor);
+        success = success && (handler->on_bool == NULL || handler->on_bool(context, value));
+
+        break;
+    }
+
+    case 'n':
+    {
+        success = json_is_literal(cursor, "null") && json_is_value_end(**cursor);
+        success = success && (handler->on_null == NULL || handler->on_null(context));
+
+        break;
+    }
+
+    default:
+    {
+        success = json_parse_number(parser, &scalar);
+
+        if (success && scalar.type == TYPE_INTEGER)
+            success = (handler->on_integer == NULL || handler->on_integer(context, scalar.value.integer));
+        else if (success)
+            success = (handler->on_number == NULL || handler->on_number(context, scalar.value.number));
+    }
+    }
+
+    return success;
+}
+
+
+/*
+ * Функция потокового разбора объекта (открывающая скобка уже пропущена)
+ *
+ * Входные данные:
+ *  parser - состояние разбора
+ *
+ * Возвращаемое значение:
+ *  1 - при успешном разборе, иначе 0
+ */
+static int json_sax_parse_object (json_parser *parser)
+{
+    const json_sax_handler *handler = parser->sax;
+    void *context = parser->sax_context;
+    int success = (handler->on_object_begin == NULL || handler->on_object_begin(context));
+
+    while (success && !json_parser_has_char(parser, '}'))
+    {
+        json_value key = { .type = TYPE_NULL };
+
+        json_parser_skip_whitespace(parser);
+
+        if (parser->structurals != NULL)
+            parser->structural_pos++;
+
+        success = (*parser->cursor == '"') && json_parse_string(parser, &key);
+        success = (success && json_parser_has_char(parser, ':'));
+
+        if (success && handler->on_key != NULL)
+        {
+            uint32_t hash = json_hash_string(key.value.string.data, key.value.string.length);
+            success = handler->on_key(context, key.value.string.data, key.value.string.length, hash);
+        }
+
+        success = (success && json_sax_parse_value(parser));
+
+        if (!success)
+            break;
+
+        if (json_parser_has_char(parser, '}'))
+            break;
+        else if (json_parser_has_char(parser, ','))
+            continue;
+        else
+            success = 0;
+    }
+
+    return success && (handler->on_object_end == NULL || handler->on_object_end(context));
+}
+
+
+/*
+ * Функция потокового разбора массива (открывающая скобка уже пропущена)
+ *
+ * Входные данные:
+ *  parser - состояние разбора
+ *
+ * Возвращаемое значение:
+ *  1 - при успешном разборе, иначе 0
+ */
+static int json_sax_parse_array (json_parser *parser)
+{
+    const json_sax_handler *handler = parser->sax;
+    void *context = parser->sax_context;
+    int success = (handler->on_array_begin == NULL || handler->on_array_begin(context));
+
+    if (success && !json_parser_has_char(parser, ']'))
+    {
+        while (success)
+        {
+            success = json_sax_parse_value(parser);
+
+            if (!success)
+                break;
+
+            if (json_parser_has_char(parser, ']'))
+                break;
+            else if (json_parser_has_char(parser, ','))
+                continue;
+            else
+                success = 0;
+        }
+    }
+
+    return success && (handler->on_array_end == NULL || handler->on_array_end(context));
+}
+
+
+/*
+ * Функция потокового разбора JSON-файла без построения дерева. Строки разбираются на месте
+ * (экранирование раскрывается во входном буфере), поэтому данные строк в обработчиках
+ * действительны, пока существует input
+ * Входные данные:
+ *  input   - указатель на изменяемый массив с данными JSON файла
+ *  handler - обработчики событий
+ *  context - контекст, передаваемый обработчикам
+ *
+ * Возвращаемое значение:
+ *  1 - при успешном разборе, 0 - ошибка разбора либо разбор прерван обработчиком
+ */
+int json_parse_sax (char *input, const json_sax_handler *handler, void *context)
+{
+    return json_parse_sax_scratch(input, handler, context, NULL);
+}
+
+
+/*
+ * Функция потокового разбора JSON-файла с повторным использованием буферов между документами
+ * Входные данные:
+ *  input   - указатель на изменяемый массив с данными JSON файла
+ *  handler - обработчики событий
+ *  context - контекст, передаваемый обработчикам
+ *  scratch - буферы разбора (NULL - выделяются на время разбора)
+ *
+ * Возвращаемое значение:
+ *  1 - при успешном разборе, 0 - ошибка разбора либо разбор прерван обработчиком
+ */
+int json_parse_sax_scratch (char *input, const json_sax_handler *handler, void *context, json_scratch *scratch)
+{
+    json_parser parser = { .cursor = input, .flags = JSON_PARSE_IN_SITU, .allocator = NULL,
+                           .scratch = scratch, .sax = handler, .sax_context = context };
+
+    json_build_structural_index(&parser, parser.cursor, strlen(parser.cursor));
+
+    int success = json_sax_parse_value(&parser);
+
+    json_release_structural_index(&parser);
+
+    return success;
+}
+
+
+/*
+ * Функция освобождения буферов разбора
+ *
+ * Входные данные:
+ *  scratch - буферы разбора
+ */
+void json_scratch_free (json_scratch *scratch)
+{
+    JSON_STATS_FREE(scratch->structurals);
+    free(scratch->structurals);
+    scratch->structurals = NULL;
+    scratch->capacity = 0;
+}
+
+
+/*
+ * Функция инициализации разбора по частям
+ *
+ * Входные данные:
+ *  stream  - состояние разбора
+ *  handler - обработчики событий
+ *  context - контекст, передаваемый обработчикам
+ */
+void json_stream_init (json_stream *stream, const json_sax_handler *handler, void *context)
+{
+    memset(stream, 0, sizeof(*stream));
+    stream->handler = handler;
+    stream->context = context;
+    stream->state = JSON_STREAM_VALUE;
+}
+
+
+/*
+ * Функция освобождения памяти разбора по частям
+ *
+ * Входные данные:
+ *  stream - состояние разбора
+ */
+void json_stream_free (json_stream *stream)
+{
+    free(stream->stack);
+    free(stream->token);
+    stream->stack = NULL;
+    stream->token = NULL;
+    stream->stack_capacity = 0;
+    stream->token_capacity = 0;
+}
+
+
+/*
+ * Функция добавления символов к незавершенной лексеме (за лексемой всегда остается место под нуль)
+ *
+ * Входные данные:
+ *  stream - состояние разбора
+ *  data   - символы
+ *  size   - число символов
+ *
+ * Возвращаемое значение:
+ *  1 - успешно, 0 - ошибка выделения памяти
+ */
+static int json_stream_token_append (json_stream *stream, const char *data, size_t size)
+{
+    if (stream->token_length + size + 1 > stream->token_capacity)
+    {
+        size_t capacity = stream->token_capacity ? stream->token_capacity : 256;
+
+        while (stream->token_length + size + 1 > capacity)
+            capacity *= 2;
+
+        char *token = realloc(stream->token, capacity);
+
+        if (token == NULL)
+            return 0;
+
+        stream->token = token;
+        stream->token_capacity = capacity;
+    }
+
+    memcpy(stream->token + stream->token_length, data, size);
+    stream->token_length += size;
+
+    return 1;
+}
+
+
+/*
+ * Функция перехода после завершенного значения
+ *
+ * Входные данные:
+ *  stream - состояние разбора
+ */
+static void json_stream_value_done (json_stream *stream)
+{
+    stream->state = (stream->depth == 0) ? JSON_STREAM_DONE : JSON_STREAM_COMMA_OR_END;
+}
+
+
+/*
+ * Функция обработки завершенной строки: раскрытие экранирования и вызов обработчика ключа или строки
+ *
+ * Входные данные:
+ *  stream - состояние разбора
+ *
+ * Возвращаемое значение:
+ *  1 - успешно, иначе 0
+ */
+static int json_stream_emit_string (json_stream *stream)
+{
+    const json_sax_handler *handler = stream->handler;
+    char *data = stream->token;
+    long length = (long)stream->token_length;
+
+    if (stream->escaped)
+        length = json_unescape_string(data, data + length, data);
+
+    if (length < 0)
+        return 0;
+
+    if (stream->is_key)
+    {
+        stream->state = JSON_STREAM_COLON;
+
+        return (handler->on_key == NULL ||
+                handler->on_key(stream->context, data, (size_t)length, json_hash_string(data, (size_t)length)));
+    }
+
+    json_stream_value_done(stream);
+
+    return (handler->on_string == NULL || handler->on_string(stream->context, data, (size_t)length));
+}
+
+
+/*
+ * Функция обработки завершенного числа или литерала
+ *
+ * Входные данные:
+ *  stream     - состояние разбора
+ *  terminator - символ, следующий за лексемой ('\0' - конец входных данных)
+ *
+ * Возвращаемое значение:
+ *  1 - успешно, иначе 0
+ */
+static int json_stream_emit_scalar (json_stream *stream, char terminator)
+{
+    const json_sax_handler *handler = stream->handler;
+    void *context = stream->context;
+    int success = 0;
+
+    if (!json_is_value_end((unsigned char)terminator))
+        return 0;
+
+    stream->token[stream->token_length] = '\0';
+
+    if (stream->state == JSON_STREAM_NUMBER)
+    {
+        json_parser parser = { .cursor = stream->token };
+        json_value scalar = { .type = TYPE_NULL };
+
+        success = json_parse_number(&parser, &scalar);
+
+        if (success && scalar.type == TYPE_INTEGER)
+            success = (handler->on_integer == NULL || handler->on_integer(context, scalar.value.integer));
+        else if (success)
+            success = (handler->on_number == NULL || handler->on_number(context, scalar.value.number));
+    }
+    else if (strcmp(stream->token, "true") == 0 || strcmp(stream->token, "false") == 0)
+    {
+        success = (handler->on_bool == NULL || handler->on_bool(context, stream->token[0] == 't'));
+    }
+    else if (strcmp(stream->token, "null") == 0)
+    {
+        success = (handler->on_null == NULL || handler->on_null(context));
+    }
+
+    json_stream_value_done(stream);
+
+    return success;
+}
+
+
+/*
+ * Функция начала значения по его первому символу
+ *
+ * Входные данные:
+ *  stream - состояние разбора
+ *  c      - первый символ значения
+ *
+ * Возвращаемое значение:
+ *  1 - успешно, иначе 0
+ */
+static int json_stream_begin_value (json_stream *stream, char c)
+{
+    const json_sax_handler *handler = stream->handler;
+
+    stream->token_length = 0;
+
+    if (c == '{' || c == '[')
+    {
+        if (stream->depth == stream->stack_capacity)
+        {
+            size_t capacity = stream->stack_capacity ? stream->stack_capacity * 2 : 64;
+            char *stack = realloc(stream->stack, capacity);
+
+            if (stack == NULL)
+                return 0;
+
+            stream->stack = stack;
+            stream->stack_capacity = capacity;
+        }
+
+        stream->stack[stream->depth++] = c;
+
+        if (c == '{')
+        {
+            stream->state = JSON_STREAM_KEY_OR_END;
+            return (handler->on_object_begin == NULL || handler->on_object_begin(stream->context));
+        }
+
+        stream->state = JSON_STREAM_VALUE_OR_END;
+        return (handler->on_array_begin == NULL || handler->on_array_begin(stream->context));
+    }
+
+    if (c == '"')
+    {
+        stream->state = JSON_STREAM_STRING;
+        stream->is_key = 0;
+        stream->escape = 0;
+        stream->escaped = 0;
+
+        // Буфер лексемы выделяется заранее, чтобы пустая строка тоже имела адрес
+        return json_stream_token_append(stream, &c, 0);
+    }
+
+    if (c == '-' || (c >= '0' && c <= '9'))
+        stream->state = JSON_STREAM_NUMBER;
+    else if (c >= 'a' && c <= 'z')
+        stream->state = JSON_STREAM_LITERAL;
+    else
+        return 0;
+
+    return json_stream_token_append(stream, &c, 1);
+}
+
+
+/*
+ * Функция закрытия контейнера
+ *
+ * Входные данные:
+ *  stream - состояние разбора
+ *  c      - закрывающая скобка
+ *
+ * Возвращаемое значение:
+ *  1 - успешно, иначе 0
+ */
+static int json_stream_end_container (json_stream *stream, char c)
+{
+    const json_sax_handler *handler = stream->handler;
+    char open = (c == '}') ? '{' : '[';
+
+    if (stream->depth == 0 || stream->stack[stream->depth - 1] != open)
+        return 0;
+
+    stream->depth--;
+    json_stream_value_done(stream);
+
+    if (c == '}')
+        return (handler->on_object_end == NULL || handler->on_object_end(stream->context));
+
+    return (handler->on_array_end == NULL || handler->on_array_end(stream->context));
+}
+
+
+/*
+ * Функция разбора очередного фрагмента входных данных
+ *
+ * Входные данные:
+ *  stream - состояние разбора
+ *  data   - фрагмент (не обязан заканчиваться на границе лексемы)
+ *  size   - размер фрагмента
+ *
+ * Возвращаемое значение:
+ *  JSON_STREAM_NEED_MORE, JSON_STREAM_COMPLETE или JSON_STREAM_ERROR
+ */
+int json_stream_feed (json_stream *stream, const char *data, size_t size)
+{
+    const char *p = data;
+    const char *end = data + size;
+    int success = 1;
+
+    while (success && p < end && stream->state < JSON_STREAM_DONE)
+    {
+        char c = *p;
+
+        switch (stream->state)
+        {
+        case JSON_STREAM_STRING:
+        {
+            // Копирование участка строки до кавычки или обратной косой черты одним блоком
+            const char *run = p;
+
+            while (p < end && *p != '"' && *p != '\\')
+                ++p;
+
+            if (stream->escape && run < p)
+                stream->escape = 0;
+
+            success = json_stream_token_append(stream, run, (size_t)(p - run));
+
+            if (!success || p == end)
+                break;
+
+            if (*p == '\\')
+            {
+                stream->escape = !stream->escape;
+                stream->escaped = 1;
+                success = json_stream_token_append(stream, p, 1);
+            }
+            else if (stream->escape)
+            {
+                stream->escape = 0;
+                success = json_stream_token_append(stream, p, 1);
+            }
+            else
+            {
+                success = json_stream_emit_string(stream);
+            }
+
+            ++p;
+
+            break;
+        }
+
+        case JSON_STREAM_NUMBER:
+        case JSON_STREAM_LITERAL:
+        {
+            const char *run = p;
+
+            if (stream->state == JSON_STREAM_NUMBER)
+            {
+                while (p < end && ((*p >= '0' && *p <= '9') || *p == '.' || *p == 'e' || *p == 'E' || *p == '+' || *p == '-'))
+                    ++p;
+            }
+            else
+            {
+                while (p < end && *p >= 'a' && *p <= 'z')
+                    ++p;
+            }
+
+            success = json_stream_token_append(stream, run, (size_t)(p - run));
+
+            // Символ, завершивший лексему, обрабатывается в следующем состоянии
+            if (success && p < end)
+                success = json_stream_emit_scalar(stream, *p);
+
+            break;
+        }
+
+        default:
+        {
+            ++p;
+
+            if (json_is_whitespace((unsigned char)c))
+                break;
+
+            switch (stream->state)
+            {
+            case JSON_STREAM_VALUE_OR_END:
+                success = (c == ']') ? json_stream_end_container(stream, c) : json_stream_begin_value(stream, c);
+                break;
+
+            case JSON_STREAM_KEY_OR_END:
+                if (c == '}')
+                {
+                    success = json_stream_end_container(stream, c);
+                }
+                else
+                {
+                    success = (c == '"') && json_stream_begin_value(stream, c);
+                    stream->is_key = 1;
+                }
+                break;
+
+            case JSON_STREAM_COLON:
+                success = (c == ':');
+                stream->state = JSON_STREAM_VALUE;
+                break;
+
+            case JSON_STREAM_COMMA_OR_END:
+                if (c == ',')
+                    stream->state = (stream->stack[stream->depth - 1] == '{') ? JSON_STREAM_KEY_OR_END : JSON_STREAM_VALUE;
+                else
+                    success = (c == '}' || c == ']') && json_stream_end_container(stream, c);
+                break;
+
+            default:
+                success = json_stream_begin_value(stream, c);
+            }
+        }
+        }
+    }
+
+    if (!success)
+        stream->state = JSON_STREAM_FAILED;
+
+    if (stream->state == JSON_STREAM_FAILED)
+        return JSON_STREAM_ERROR;
+
+    return (stream->state == JSON_STREAM_DONE) ? JSON_STREAM_COMPLETE : JSON_STREAM_NEED_MORE;
+}
+
+
+/*
+ * Функция завершения разбора по частям после последнего фрагмента. Завершает корневое
+ * число или литерал, за которым не было разделителя
+ *
+ * Входные данные:
+ *  stream - состояние разбора
+ *
+ * Возвращаемое значение:
+ *  JSON_STREAM_COMPLETE либо JSON_STREAM_ERROR, если корневое значение не завершено
+ */
+int json_stream_finish (json_stream *stream)
+{
+    if ((stream->state == JSON_STREAM_NUMBER || stream->state == JSON_STREAM_LITERAL) && stream->depth == 0)
+    {
+        if (!json_stream_emit_scalar(stream, '\0'))
+            stream->state = JSON_STREAM_FAILED;
+    }
+
+    return (stream->state == JSON_STREAM_DONE) ? JSON_STREAM_COMPLETE : JSON_STREAM_ERROR;
+}
+
+
+/*
+ * Функция инициализации ленты
+ *
+ * Входные данные:
+ *  tape - лента
+ */
+void json_tape_init (json_tape *tape)
+{
+    memset(tape, 0, sizeof(*tape));
+}
+
+
+/*
+ * Функция освобождения буферов ленты
+ *
+ * Входные данные:
+ *  tape - лента
+ */
+void json_tape_free (json_tape *tape)
+{
+    free(tape->tokens);
+    free(tape->strings);
+    free(tape->stack);
+    json_tape_init(tape);
+}
+
+
+/*
+ * Функция резервирования элементов ленты
+ *
+ * Входные данные:
+ *  tape     - лента
+ *  capacity - требуемое число элементов
+ *
+ * Возвращаемое значение:
+ *  1 - успешно, 0 - ошибка выделения памяти
+ */
+static int json_tape_reserve (json_tape *tape, size_t capacity)
+{
+    if (capacity <= tape->capacity)
+        return 1;
+
+    json_tape_token *tokens = realloc(tape->tokens, capacity * sizeof(json_tape_token));
+
+    if (tokens == NULL)
+    {
+        tape->out_of_memory = 1;
+        return 0;
+    }
+
+    tape->tokens = tokens;
+    tape->capacity = capacity;
+
+    return 1;
+}
+
+
+/*
+ * Функция добавления элемента в конец ленты. Значение (не ключ) учитывается в числе
+ * элементов открытого контейнера
+ *
+ * Входные данные:
+ *  tape - лента
+ *  type - тип элемента TYPE_*
+ *
+ * Возвращаемое значение:
+ *  указатель на элемент либо NULL при ошибке выделения памяти
+ */
+static json_tape_token *json_tape_append (json_tape *tape, uint32_t type)
+{
+    if (tape->count == tape->capacity && !json_tape_reserve(tape, tape->capacity ? tape->capacity * 2 : 1024))
+        return NULL;
+
+    if (type != TYPE_KEY && tape->depth > 0)
+        tape->tokens[tape->stack[tape->depth - 1]].length++;
+
+    json_tape_token *token = &tape->tokens[tape->count++];
+
+    token->type = type;
+    token->length = 0;
+    token->value.integer = 0;
+
+    return token;
+}
+
+
+/*
+ * Функция копирования строки в буфер строк ленты
+ *
+ * Входные данные:
+ *  tape   - лента
+ *  token  - элемент строки или ключа
+ *  data   - строка
+ *  length - длина строки
+ *
+ * Возвращаемое значение:
+ *  1 - успешно, 0 - ошибка выделения памяти либо буфер строк превысил 4 ГБ
+ */
+static int json_tape_store_string (json_tape *tape, json_tape_token *token, const char *data, size_t length)
+{
+    size_t required = tape->strings_size + length + 1;
+
+    if (required > UINT32_MAX)
+    {
+        tape->out_of_memory = 1;
+        return 0;
+    }
+
+    if (required > tape->strings_capacity)
+    {
+        size_t capacity = tape->strings_capacity ? tape->strings_capacity * 2 : 4096;
+
+        while (capacity < required)
+            capacity *= 2;
+
+        char *strings = realloc(tape->strings, capacity);
+
+        if (strings == NULL)
+        {
+            tape->out_of_memory = 1;
+            return 0;
+        }
+
+        tape->strings = strings;
+        tape->strings_capacity = capacity;
+    }
+
+    memcpy(tape->strings + tape->strings_size, data, length);
+    tape->strings[tape->strings_size + length] = '\0';
+
+    token->length = (uint32_t)length;
+    token->value.string.offset = (uint32_t)tape->strings_size;
+    tape->strings_size = required;
+
+    return 1;
+}
+
+
+/*
+ * Функция получения значения, следующего за данным в том же контейнере (для объекта -
+ * следующего ключа). Вложенные контейнеры пропускаются за один шаг
+ *
+ * Входные данные:
+ *  token - значение
+ *
+ * Возвращаемое значение:
+ *  указатель на следующий элемент ленты
+ */
+static inline const json_tape_token *json_tape_next (const json_tape_token *token)
+{
+    return (token->type == TYPE_OBJECT || token->type == TYPE_ARRAY) ? token + token->value.skip : token + 1;
+}
+
+
+/*
+ * Функция вычисления места под хеш-таблицу ключей за парами объекта ленты
+ *
+ * Входные данные:
+ *  pairs - число пар ключ-значение
+ *
+ * Возвращаемое значение:
+ *  число элементов ленты, занимаемых таблицей
+ */
+static size_t json_tape_index_extra (size_t pairs)
+{
+    size_t slots_size = json_object_index_slots(pairs) * sizeof(uint32_t);
+
+    return (slots_size + sizeof(json_tape_token) - 1) / sizeof(json_tape_token);
+}
+
+
+/*
+ * Функция построения хеш-таблицы ключей большого объекта ленты при его завершении.
+ * Таблица дописывается за последней парой, ячейка хранит смещение ключа от элемента
+ * объекта (0 - свободно). Пары вставляются по порядку, поэтому при повторяющихся
+ * ключах находится первый, как и при линейном поиске
+ *
+ * Входные данные:
+ *  tape - лента
+ *  open - номер элемента объекта
+ *
+ * Возвращаемое значение:
+ *  1 - успешно, 0 - ошибка выделения памяти либо объект длиннее 4 Г элементов
+ */
+static int json_tape_index_object (json_tape *tape, size_t open)
+{
+    size_t pairs = tape->tokens[open].length;
+    size_t extra = json_tape_index_extra(pairs);
+    size_t required = tape->count + extra;
+    size_t i = 0;
+
+    if (tape->count - open > UINT32_MAX)
+    {
+        tape->out_of_memory = 1;
+        return 0;
+    }
+
+    if (required > tape->capacity && !json_tape_reserve(tape, (required > tape->capacity * 2) ? required : tape->capacity * 2))
+        return 0;
+
+    const json_tape_token *object = &tape->tokens[open];
+    const json_tape_token *key = object + 1;
+    uint32_t *slots = (uint32_t *)&tape->tokens[tape->count];
+    size_t mask = json_object_index_slots(pairs) - 1;
+
+    memset(slots, 0, extra * sizeof(json_tape_token));
+
+    for (i = 0; i < pairs; i++)
+    {
+        size_t slot = key->value.string.hash & mask;
+
+        while (slots[slot] != 0)
+            slot = (slot + 1) & mask;
+
+        slots[slot] = (uint32_t)(key - object);
+        key = json_tape_next(key + 1);
+    }
+
+    tape->count = required;
+
+    return 1;
+}
+
+
+/*
+ * Обработчики событий разбора, заполняющие ленту
+ *
+ * Входные данные:
+ *  context - лента
+ *
+ * Возвращаемое значение:
+ *  1 - успешно, 0 - ошибка выделения памяти
+ */
+static int json_tape_on_null (void *context)
+{
+    return json_tape_append(context, TYPE_NULL) != NULL;
+}
+
+static int json_tape_on_bool (void *context, int boolean)
+{
+    json_tape_token *token = json_tape_append(context, TYPE_BOOL);
+
+    if (token != NULL)
+        token->value.boolean = boolean;
+
+    return token != NULL;
+}
+
+static int json_tape_on_integer (void *context, int64_t integer)
+{
+    json_tape_token *token = json_tape_append(context, TYPE_INTEGER);
+
+    if (token != NULL)
+        token->value.integer = integer;
+
+    return token != NULL;
+}
+
+static int json_tape_on_number (void *context, double number)
+{
+    json_tape_token *token = json_tape_append(context, TYPE_NUMBER);
+
+    if (token != NULL)
+        token->value.number = number;
+
+    return token != NULL;
+}
+
+static int json_tape_on_string (void *context, const char *data, size_t length)
+{
+    json_tape_token *token = json_tape_append(context, TYPE_STRING);
+
+    return token != NULL && json_tape_store_string(context, token, data, length);
+}
+
+static int json_tape_on_key (void *context, const char *data, size_t length, uint32_t hash)
+{
+    json_tape_token *token = json_tape_append(context, TYPE_KEY);
+
+    if (token == NULL || !json_tape_store_string(context, token, data, length))
+        return 0;
+
+    token->value.string.hash = hash;
+
+    return 1;
+}
+
+static int json_tape_begin (json_tape *tape, uint32_t type)
+{
+    if (tape->depth == tape->stack_capacity)
+    {
+        size_t capacity = tape->stack_capacity ? tape->stack_capacity * 2 : 64;
+        size_t *stack = realloc(tape->stack, capacity * sizeof(size_t));
+
+        if (stack == NULL)
+        {
+            tape->out_of_memory = 1;
+            return 0;
+        }
+
+        tape->stack = stack;
+        tape->stack_capacity = capacity;
+    }
+
+    if (json_tape_append(tape, type) == NULL)
+        return 0;
+
+    tape->stack[tape->depth++] = tape->count - 1;
+
+    return 1;
+}
+
+static int json_tape_end (json_tape *tape)
+{
+    size_t open = tape->stack[--tape->depth];
+
+    if (tape->tokens[open].type == TYPE_OBJECT && tape->tokens[open].length >= JSON_OBJECT_INDEX_MIN_PAIRS &&
+        !json_tape_index_object(tape, open))
+    {
+        return 0;
+    }
+
+    tape->tokens[open].value.skip = tape->count - open;
+
+    return 1;
+}
+
+static int json_tape_on_object_begin (void *context)
+{
+    return json_tape_begin(context, TYPE_OBJECT);
+}
+
+static int json_tape_on_array_begin (void *context)
+{
+    return json_tape_begin(context, TYPE_ARRAY);
+}
+
+static int json_tape_on_end (void *context)
+{
+    return json_tape_end(context);
+}
+
+static const json_sax_handler json_tape_handler = {
+    json_tape_on_null,
+    json_tape_on_bool,
+    json_tape_on_integer,
+    json_tape_on_number,
+    json_tape_on_string,
+    json_tape_on_key,
+    json_tape_on_object_begin,
+    json_tape_on_end,
+    json_tape_on_array_begin,
+    json_tape_on_end
+};
+
+
+/*
+ * Функция разбора JSON-файла в ленту. Каждый элемент ленты, кроме корня, занимает в структурном
+ * индексе не меньше двух элементов (начало и следующий за ним ':', ',' или закрывающая скобка),
+ * поэтому лента резервируется по размеру индекса один раз (дорезервируются только хеш-таблицы
+ * ключей больших объектов). Строки копируются
+ * в буфер ленты, и после разбора входные данные не нужны. Прежнее содержимое ленты заменяется
+ * Входные данные:
+ *  input   - указатель на изменяемый массив с данными JSON файла
+ *  tape    - лента (буферы повторно используются)
+ *  scratch - буферы разбора (NULL - выделяются на время разбора)
+ *
+ * Возвращаемое значение:
+ *  1 - при успешном разборе, 0 - ошибка разбора либо выделения памяти
+ */
+int json_tape_parse (char *input, json_tape *tape, json_scratch *scratch)
+{
+    json_parser parser = { .cursor = input, .flags = JSON_PARSE_IN_SITU, .allocator = NULL,
+                           .scratch = scratch, .sax = &json_tape_handler, .sax_context = tape };
+    size_t size = strlen(input);
+
+    tape->count = 0;
+    tape->strings_size = 0;
+    tape->depth = 0;
+    tape->out_of_memory = 0;
+
+    if (json_build_structural_index(&parser, parser.cursor, size))
+        json_tape_reserve(tape, parser.structural_count / 2 + 1);
+
+    int success = !tape->out_of_memory && json_sax_parse_value(&parser);
+
+    json_release_structural_index(&parser);
+
+    if (!success)
+        tape->count = 0;
+
+    return success;
+}
+
+
+/*
+ * Функция получения корневого значения ленты
+ *
+ * Входные данные:
+ *  tape - лента
+ *
+ * Возвращаемое значение:
+ *  указатель на элемент либо NULL, если лента пуста
+ */
+const json_tape_token *json_tape_root (const json_tape *tape)
+{
+    return (tape->count > 0) ? tape->tokens : NULL;
+}
+
+
+/*
+ * Функция получения элемента массива ленты по индексу. Элементы массива без вложенных
+ * контейнеров занимают по одному элементу ленты и находятся сразу, иначе предшествующие
+ * элементы пропускаются по одному шагу на элемент
+ *
+ * Входные данные:
+ *  root  - массив
+ *  index - индекс в массиве
+ *
+ * Возвращаемое значение:
+ *  указатель на элемент либо NULL
+ */
+const json_tape_token *json_tape_at (const json_tape_token *root, size_t index)
+{
+    if (root == NULL || root->type != TYPE_ARRAY || index >= root->length)
+        return NULL;
+
+    if (root->value.skip == (uint64_t)root->length + 1)
+        return root + 1 + index;
+
+    const json_tape_token *item = root + 1;
+
+    while (index-- > 0)
+        item = json_tape_next(item);
+
+    return item;
+}
+
+
+/*
+ * Функция получения значения объекта ленты по ключу. В объекте с хеш-таблицей ключей
+ * поиск выполняется по ней, в остальных - просмотром пар с проверкой хеша
+ *
+ * Входные данные:
+ *  tape - лента
+ *  root - объект
+ *  key  - ключ
+ *
+ * Возвращаемое значение:
+ *  указатель на значение либо NULL
+ */
+const json_tape_token *json_tape_with_key (const json_tape *tape, const json_tape_token *root, const char *key)
+{
+    if (root == NULL || root->type != TYPE_OBJECT)
+        return NULL;
+
+    size_t key_length = strlen(key);
+    uint32_t hash = json_hash_string(key, key_length);
+    const json_tape_token *item = root + 1;
+    size_t i = 0;
+
+    if (root->length >= JSON_OBJECT_INDEX_MIN_PAIRS)
+    {
+        const uint32_t *slots = (const uint32_t *)(root + root->value.skip - json_tape_index_extra(root->length));
+        size_t mask = json_object_index_slots(root->length) - 1;
+        size_t slot = hash & mask;
+
+        while (slots[slot] != 0)
+        {
+            item = root + slots[slot];
+
+            if (item->value.string.hash == hash && item->length == key_length &&
+                memcmp(tape->strings + item->value.string.offset, key, key_length) == 0)
+            {
+                return item + 1;
+            }
+
+            slot = (slot + 1) & mask;
+        }
+
+        return NULL;
+    }
+
+    for (i = 0; i < root->length; i++)
+    {
+        if (item->value.string.hash == hash && item->length == key_length &&
+            memcmp(tape->strings + item->value.string.offset, key, key_length) == 0)
+        {
+            return item + 1;
+        }
+
+        item = json_tape_next(item + 1);
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Функция представления скалярного элемента ленты узлом, к которому применимы функции
+ * json_value_to_* и json_value_is_string. Строка узла указывает в буфер ленты.
+ * Контейнеры узлами не представляются: json_value_at и json_value_with_key возвращают
+ * указатель на существующий узел дерева, а лента узлов не хранит, поэтому для нее
+ * служат json_tape_at и json_tape_with_key
+ *
+ * Входные данные:
+ *  tape  - лента
+ *  token - элемент
+ *  value - узел (выходной параметр; для контейнера - TYPE_NULL)
+ */
+void json_tape_value (const json_tape *tape, const json_tape_token *token, json_value *value)
+{
+    value->type = (int)token->type;
+    value->flags = JSON_FLAG_BORROWED;
+
+    switch (token->type)
+    {
+    case TYPE_BOOL:
+        value->value.boolean = token->value.boolean;
+        break;
+
+    case TYPE_NUMBER:
+        value->value.number = token->value.number;
+        break;
+
+    case TYPE_INTEGER:
+        value->value.integer = token->value.integer;
+        break;
+
+    case TYPE_STRING:
+    case TYPE_KEY:
+        value->value.string.data = tape->strings + token->value.string.offset;
+        value->value.string.length = token->length;
+        value->value.string.hash = token->value.string.hash;
+        break;
+
+    default:
+        value->type = TYPE_NULL;
+        break;
+    }
+}
+
+
+/*
+ * Функция инициализации записи JSON
+ *
+ * Входные данные:
+ *  writer - состояние записи
+ *  fd     - дескриптор файла, -1 - запись в буфер
+ */
+void json_writer_init (json_writer *writer, int fd)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->fd = fd;
+}
+
+
+/*
+ * Функция освобождения буфера записи JSON
+ *
+ * Входные данные:
+ *  writer - состояние записи
+ */
+void json_writer_free (json_writer *writer)
+{
+    free(writer->data);
+    writer->data = NULL;
+    writer->size = 0;
+    writer->capacity = 0;
+}
+
+
+/*
+ * Функция сброса буфера в файл (без файла ничего не делает)
+ *
+ * Входные данные:
+ *  writer - состояние записи
+ *
+ * Возвращаемое значение:
+ *  SUCCESS или DEF_ERROR при ошибке записи
+ */
+int json_writer_flush (json_writer *writer)
+{
+    if (writer->fd < 0)
+        return writer->error ? DEF_ERROR : SUCCESS;
+
+    const char *data = writer->data;
+    size_t left = writer->size;
+
+    while (!writer->error && left > 0)
+    {
+        ssize_t written = write(writer->fd, data, left);
+
+        if (written < 0 && errno == EINTR)
+            continue;
+
+        if (written <= 0)
+        {
+            writer->error = 1;
+            break;
+        }
+
+        data += written;
+        left -= (size_t)written;
+    }
+
+    writer->size = 0;
+
+    return writer->error ? DEF_ERROR : SUCCESS;
+}
+
+
+/*
+ * Функция резервирования места в буфере записи
+ *
+ * Входные данные:
+ *  writer - состояние записи
+ *  size   - требуемый размер
+ *
+ * Возвращаемое значение:
+ *  указатель на свободное место либо NULL при ошибке
+ */
+static char *json_writer_reserve (json_writer *writer, size_t size)
+{
+    if (writer->capacity - writer->size >= size)
+        return writer->data + writer->size;
+
+    if (writer->error)
+        return NULL;
+
+    if (writer->fd >= 0 && writer->size >= JSON_WRITER_FLUSH)
+    {
+        json_writer_flush(writer);
+
+        if (writer->capacity - writer->size >= size)
+            return writer->data + writer->size;
+    }
+
+    size_t capacity = (writer->capacity > 0) ? writer->capacity * 2 : JSON_WRITER_FLUSH * 2;
+
+    while (capacity - writer->size < size)
+        capacity *= 2;
+
+    char *data = realloc(writer->data, capacity);
+
+    if (data == NULL)
+    {
+        writer->error = 1;
+        return NULL;
+    }
+
+    writer->data = data;
+    writer->capacity = capacity;
+
+    return data + writer->size;
+}
+
+
+/*
+ * Функция добавления данных в буфер записи
+ *
+ * Входные данные:
+ *  writer - состояние записи
+ *  data   - данные
+ *  size   - размер данных
+ */
+static inline void json_writer_put (json_writer *writer, const char *data, size_t size)
+{
+    char *out = json_writer_reserve(writer, size);
+
+    if (out != NULL)
+    {
+        memcpy(out, data, size);
+        writer->size += size;
+    }
+}
+
+
+// Символы, которые в строке JSON записываются escape-последовательностью: 0 - без изменений,
+// 'u' - \u00XX, иначе второй символ последовательности. Байты UTF-8 (>= 0x80) не изменяются
+static const char json_escape_table[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+};
+
+
+/*
+ * Функция записи строки в кавычках. Участки без специальных символов копируются целиком
+ *
+ * Входные данные:
+ *  writer - состояние записи
+ *  data   - строка
+ *  length - длина строки
+ */
+static void json_write_string (json_writer *writer, const char *data, size_t length)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t start = 0;
+    size_t i = 0;
+
+    json_writer_put(writer, "\"", 1);
+
+    for (i = 0; i < length; i++)
+    {
+        char escape = json_escape_table[(unsigned char)data[i]];
+
+        if (escape == 0)
+            continue;
+
+        json_writer_put(writer, data + start, i - start);
+        start = i + 1;
+
+        if (escape == 'u')
+        {
+            char sequence[6] = { '\\', 'u', '0', '0', hex[(unsigned char)data[i] >> 4], hex[data[i] & 0xF] };
+
+            json_writer_put(writer, sequence, sizeof(sequence));
+        }
+        else
+        {
+            char sequence[2] = { '\\', escape };
+
+            json_writer_put(writer, sequence, sizeof(sequence));
+        }
+    }
+
+    json_writer_put(writer, data + start, length - start);
+    json_writer_put(writer, "\"", 1);
+}
+
+
+/*
+ * Функция записи целого числа (по две цифры за шаг)
+ *
+ * Входные данные:
+ *  writer  - состояние записи
+ *  integer - число
+ */
+static void json_write_integer (json_writer *writer, int64_t integer)
+{
+    static const char pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    char digits[20];
+    char *p = digits + sizeof(digits);
+    uint64_t value = (integer < 0) ? 0 - (uint64_t)integer : (uint64_t)integer;
+
+    while (value >= 100)
+    {
+        size_t pair = (size_t)(value % 100) * 2;
+
+        value /= 100;
+        p -= 2;
+        p[0] = pairs[pair];
+        p[1] = pairs[pair + 1];
+    }
+
+    if (value >= 10)
+    {
+        p -= 2;
+        p[0] = pairs[value * 2];
+        p[1] = pairs[value * 2 + 1];
+    }
+    else
+    {
+        *--p = (char)('0' + value);
+    }
+
+    if (integer < 0)
+        *--p = '-';
+
+    json_writer_put(writer, p, (size_t)(digits + sizeof(digits) - p));
+}
+
+
+/*
+ * Функция записи дробного числа кратчайшим из представлений с 15 и 17 значащими цифрами,
+ * которое читается обратно без потерь. Число без дробной части и порядка дополняется ".0",
+ * чтобы при повторном разборе осталось дробным. Бесконечность и NaN записываются как null
+ *
+ * Входные данные:
+ *  writer - состояние записи
+ *  number - число
+ */
+static void json_write_number (json_writer *writer, double number)
+{
+    char text[32];
+
+    if (number != number || number - number != 0)
+    {
+        json_writer_put(writer, "null", 4);
+        return;
+    }
+
+    int length = snprintf(text, sizeof(text), "%.15g", number);
+
+    if (strtod(text, NULL) != number)
+        length = snprintf(text, sizeof(text), "%.17g", number);
+
+    if (strpbrk(text, ".eE") == NULL)
+    {
+        memcpy(text + length, ".0", 2);
+        length += 2;
+    }
+
+    json_writer_put(writer, text, (size_t)length);
+}
+
+
+/*
+ * Функция перевода строки с отступом (в компактном режиме ничего не делает)
+ *
+ * Входные данные:
+ *  writer - состояние записи
+ *  flags  - режимы записи JSON_WRITE_*
+ *  depth  - уровень вложенности
+ */
+static void json_write_newline (json_writer *writer, int flags, size_t depth)
+{
+    if (!(flags & JSON_WRITE_PRETTY))
+        return;
+
+    char *out = json_writer_reserve(writer, depth + 1);
+
+    if (out != NULL)
+    {
+        out[0] = '\n';
+        memset(out + 1, '\t', depth);
+        writer->size += depth + 1;
+    }
+}
+
+
+/*
+ * Функция записи узла и его дочерних узлов
+ *
+ * Входные данные:
+ *  writer - состояние записи
+ *  value  - узел
+ *  flags  - режимы записи JSON_WRITE_*
+ *  depth  - уровень вложенности узла
+ */
+static void json_write_node (json_writer *writer, const json_value *value, int flags, size_t depth)
+{
+    switch (value->type)
+    {
+    case TYPE_BOOL:
+        if (value->value.boolean)
+            json_writer_put(writer, "true", 4);
+        else
+            json_writer_put(writer, "false", 5);
+        break;
+
+    case TYPE_INTEGER:
+        json_write_integer(writer, value->value.integer);
+        break;
+
+    case TYPE_NUMBER:
+        json_write_number(writer, value->value.number);
+        break;
+
+    case TYPE_STRING:
+    case TYPE_KEY:
+        json_write_string(writer, value->value.string.data, value->value.string.length);
+        break;
+
+    case TYPE_ARRAY:
+    case TYPE_OBJECT:
+    {
+        const json_value *items = (const json_value *)value->value.array.data;
+        size_t size = value->value.array.size;
+        size_t step = (value->type == TYPE_OBJECT) ? 2 : 1;
+        size_t i = 0;
+
+        json_writer_put(writer, (value->type == TYPE_OBJECT) ? "{" : "[", 1);
+
+        for (i = 0; i + step <= size; i += step)
+        {
+            if (i > 0)
+                json_writer_put(writer, ",", 1);
+
+            json_write_newline(writer, flags, depth + 1);
+
+            if (step == 2)
+            {
+                json_write_string(writer, items[i].value.string.data, items[i].value.string.length);
+                json_writer_put(writer, (flags & JSON_WRITE_PRETTY) ? ": " : ":", (flags & JSON_WRITE_PRETTY) ? 2 : 1);
+            }
+
+            json_write_node(writer, &items[i + step - 1], flags, depth + 1);
+        }
+
+        if (size > 0)
+            json_write_newline(writer, flags, depth);
+
+        json_writer_put(writer, (value->type == TYPE_OBJECT) ? "}" : "]", 1);
+        break;
+    }
+
+    default:
+        json_writer_put(writer, "null", 4);
+        break;
+    }
+}
+
+
+/*
+ * Функция записи дерева JSON в текст. При записи в файл данные сбрасываются блоками,
+ * остаток - при вызове json_writer_flush
+ *
+ * Входные данные:
+ *  writer - состояние записи
+ *  value  - корневой узел
+ *  flags  - режимы записи JSON_WRITE_*
+ *
+ * Возвращаемое значение:
+ *  SUCCESS или DEF_ERROR при ошибке записи или выделения памяти
+ */
+int json_write_value (json_writer *writer, const json_value *value, int flags)
+{
+    json_write_node(writer, value, flags, 0);
+
+    if (flags & JSON_WRITE_PRETTY)
+        json_writer_put(writer, "\n", 1);
+
+    return writer->error ? DEF_ERROR : SUCCESS;
+}
+
+
+/*
+ * Функция записи дерева JSON в строку
+ *
+ * Входные данные:
+ *  value  - корневой узел
+ *  flags  - режимы записи JSON_WRITE_*
+ *  length - длина строки без завершающего нуля (выходной параметр, может быть NULL)
+ *
+ * Возвращаемое значение:
+ *  строка (освобождается free) либо NULL при ошибке выделения памяти
+ */
+char *json_serialize (const json_value *value, int flags, size_t *length)
+{
+    json_writer writer;
+
+    json_writer_init(&writer, -1);
+
+    if (json_write_value(&writer, value, flags) != SUCCESS || json_writer_reserve(&writer, 1) == NULL)
+    {
+        json_writer_free(&writer);
+        return NULL;
+    }
+
+    writer.data[writer.size] = '\0';
+
+    if (length != NULL)
+        *length = writer.size;
+
+    return writer.data;
+}
+
+
+/*
+ * Функция записи дерева JSON в файл
+ *
+ * Входные данные:
+ *  value - корневой узел
+ *  fd    - дескриптор файла
+ *  flags - режимы записи JSON_WRITE_*
+ *
+ * Возвращаемое значение:
+ *  SUCCESS или DEF_ERROR при ошибке записи или выделения памяти
+ */
+int json_write_fd (const json_value *value, int fd, int flags)
+{
+    json_writer writer;
+
+    json_writer_init(&writer, fd);
+
+    int result = json_write_value(&writer, value, flags);
+
+    if (json_writer_flush(&writer) != SUCCESS)
+        result = DEF_ERROR;
+
+    json_writer_free(&writer);
+
+    return result;
+}
+
+
+// Способы декодирования полей ВК
+#define VC_FIELD_U32            0   // целое число 0..UINT32_MAX
+#define VC_FIELD_ENUM           1   // строка из таблицы значений, записывается код (1 байт)
+#define VC_FIELD_COMMENT        2   // комментарий, записывается как "\n# <текст>\n"
+#define VC_FIELD_STRING         3   // строка фиксированной длины с завершающим нулем
+#define VC_FIELD_ACTIVE         4   // "ON" - VC_ON, любое другое значение - VC_OFF
+#define VC_FIELD_CHANNEL_TYPE   5   // тип канала; для ASM дублирование AB заменяется на A
+
+// Флаги полей ВК
+#define VC_REQUIRED             0x01    // при отсутствии ключа запись считается некорректной
+
+// Максимальное число полей в описании записи и размер таблицы поиска по ключу
+#define VC_SCHEMA_MAX_FIELDS    32
+#define VC_SCHEMA_SLOTS         64
+
+// Значение перечисления
+typedef struct
+{
+    const char *name;   // строковое значение в JSON
+    uint8_t code;       // значение поля
+} vc_enum_t;
+
+// Описание поля ВК
+typedef struct
+{
+    const char *key;            // ключ JSON
+    size_t offset;              // смещение поля в структуре
+    size_t size;                // размер поля
+    int kind;                   // способ декодирования VC_FIELD_*
+    const vc_enum_t *values;    // таблица значений (VC_FIELD_ENUM, VC_FIELD_CHANNEL_TYPE), завершается name == NULL
+    size_t link_offset;         // смещение поля дублирования (VC_FIELD_CHANNEL_TYPE)
+    int flags;                  // флаги VC_REQUIRED
+} vc_field_t;
+
+// Описание записи: поля в порядке проверки и таблица поиска поля по хешу ключа
+typedef struct
+{
+    const vc_field_t *fields;
+    size_t count;
+    uint32_t hashes[VC_SCHEMA_MAX_FIELDS];  // хеши ключей полей
+    uint8_t slots[VC_SCHEMA_SLOTS];         // номер поля + 1, 0 - свободно
+    int ready;
+} vc_schema_t;
+
+#define VC_FIELD(record, field, key, kind, values, flags) \
+    { key, offsetof(record, field), sizeof(((record *)0)->field), kind, values, 0, flags }
+
+#define VC_FIELD_LINKED(record, field, key, kind, values, link, flags) \
+    { key, offsetof(record, field), sizeof(((record *)0)->field), kind, values, offsetof(record, link), flags }
+
+static const vc_enum_t vc_type_values[] = {
+    { "LOW", VC_TYPE_LOW },
+    { "HIGH", VC_TYPE_HIGH },
+    { NULL, 0 }
+};
+
+#ifdef ETHERNET_MODE
+static const vc_enum_t vc_active_values[] = {
+    { "ON", VC_ON },
+    { NULL, 0 }
+};
+
+// Поля ВК регулярного сообщения в порядке проверки
+static const vc_field_t vc_regular_fields[] = {
+    VC_FIELD(vc_regular_data_t, enabled,         "active",          VC_FIELD_ENUM,    vc_active_values, VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, type,            "type",            VC_FIELD_ENUM,    vc_type_values,   VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, client_ip,       "client_ip",       VC_FIELD_STRING,  NULL,             VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, client_rcv_port, "client_rcv_port", VC_FIELD_U32,     NULL,             VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, server_rcv_port, "server_rcv_port", VC_FIELD_U32,     NULL,             VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, server_snd_port, "server_snd_port", VC_FIELD_U32,     NULL,             VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, priority,        "priority",        VC_FIELD_U32,     NULL,             VC_REQUIRED),
+};
+
+// Поля ВК периодического сообщения (после проверки "active")
+static const vc_field_t vc_periodical_fields[] = {
+    VC_FIELD(vc_periodical_data_t, server_ip,       "server_ip",       VC_FIELD_STRING, NULL, VC_REQUIRED),
+    VC_FIELD(vc_periodical_data_t, client_ip,       "client_ip",       VC_FIELD_STRING, NULL, VC_REQUIRED),
+    VC_FIELD(vc_periodical_data_t, client_rcv_port, "client_rcv_port", VC_FIELD_U32,    NULL, VC_REQUIRED),
+    VC_FIELD(vc_periodical_data_t, server_snd_port, "server_snd_port", VC_FIELD_U32,    NULL, VC_REQUIRED),
+    VC_FIELD(vc_periodical_data_t, period,          "period",          VC_FIELD_U32,    NULL, VC_REQUIRED),
+    VC_FIELD(vc_periodical_data_t, max_size,        "max_size",        VC_FIELD_U32,    NULL, VC_REQUIRED),
+};
+#else
+static const vc_enum_t vc_duplication_values[] = {
+    { "A", VC_DUPLICATION_A },
+    { "B", VC_DUPLICATION_B },
+    { "AB", VC_DUPLICATION_AB },
+    { NULL, 0 }
+};
+
+static const vc_enum_t vc_channel_type_values[] = {
+    { "FCRT", VC_FCRT },
+    { "ASM", VC_ASM },
+    { NULL, 0 }
+};
+
+// Поля ВК регулярного сообщения в порядке проверки
+static const vc_field_t vc_regular_fields[] = {
+    VC_FIELD(vc_regular_data_t, enabled,         "active",        VC_FIELD_ACTIVE,  NULL,                  VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, comment,         "comment",       VC_FIELD_COMMENT, NULL,                  VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, type,            "type",          VC_FIELD_ENUM,    vc_type_values,        VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, dst_id,          "dst_id",        VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+#ifdef GREK_FCRT
+    VC_FIELD(vc_regular_data_t, period,          "period",        VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+#else
+    VC_FIELD(vc_regular_data_t, src_id,          "src_id",        VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, input_port,      "input_port",    VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, output_port,     "output_port",   VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+#endif
+    VC_FIELD(vc_regular_data_t, priority,        "priority",      VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, input_asm_id,    "input_asm_id",  VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, output_asm_id,   "output_asm_id", VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, max_size,        "max_size",      VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, input_queue,     "input_queue",   VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, output_queue,    "output_queue",  VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+    VC_FIELD(vc_regular_data_t, duplication,     "duplication",   VC_FIELD_ENUM,    vc_duplication_values, VC_REQUIRED),
+    VC_FIELD_LINKED(vc_regular_data_t, channel_type, "channel_type", VC_FIELD_CHANNEL_TYPE, vc_channel_type_values, duplication, VC_REQUIRED),
+#ifndef GREK_FCRT
+    VC_FIELD(vc_regular_data_t, timeout_AB,      "timeout_AB",    VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+#endif
+};
+
+// Поля ВК периодического сообщения (после проверки "active")
+static const vc_field_t vc_periodical_fields[] = {
+#ifndef GREK_FCRT
+    VC_FIELD(vc_periodical_data_t, comment,       "comment",       VC_FIELD_COMMENT, NULL,                  0),
+    VC_FIELD(vc_periodical_data_t, dst_id,        "dst_id",        VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+    VC_FIELD(vc_periodical_data_t, src_id,        "src_id",        VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+#endif
+    VC_FIELD(vc_periodical_data_t, output_port,   "output_port",   VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+    VC_FIELD(vc_periodical_data_t, period,        "period",        VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+    VC_FIELD(vc_periodical_data_t, output_asm_id, "output_asm_id", VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+    VC_FIELD(vc_periodical_data_t, max_size,      "max_size",      VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+    VC_FIELD(vc_periodical_data_t, duplication,   "duplication",   VC_FIELD_ENUM,    vc_duplication_values, VC_REQUIRED),
+#ifdef GREK_FCRT
+    VC_FIELD_LINKED(vc_periodical_data_t, channel_type, "channel_type", VC_FIELD_CHANNEL_TYPE, vc_channel_type_values, duplication, VC_REQUIRED),
+#else
+    VC_FIELD(vc_periodical_data_t, priority,      "priority",      VC_FIELD_U32,     NULL,                  VC_REQUIRED),
+#endif
+};
+#endif
+
+static vc_schema_t vc_regular_schema = { .fields = vc_regular_fields,
+                                         .count = sizeof(vc_regular_fields) / sizeof(vc_regular_fields[0]) };
+static vc_schema_t vc_periodical_schema = { .fields = vc_periodical_fields,
+                                            .count = sizeof(vc_periodical_fields) / sizeof(vc_periodical_fields[0]) };
+
+
+/*
+ * Функция построения таблицы поиска поля по хешу ключа. Вызывается до первого
+ * использования описания (повторный вызов ничего не делает)
+ *
+ * Входные данные:
+ *  schema - описание записи
+ */
+static void vc_schema_init (vc_schema_t *schema)
+{
+    size_t i = 0;
+
+    if (schema->ready)
+        return;
+
+    memset(schema->slots, 0, sizeof(schema->slots));
+
+    for (i = 0; i < schema->count; i++)
+    {
+        const char *key = schema->fields[i].key;
+        uint32_t hash = json_hash_string(key, strlen(key));
+        size_t slot = hash & (VC_SCHEMA_SLOTS - 1);
+
+        while (schema->slots[slot] != 0)
+            slot = (slot + 1) & (VC_SCHEMA_SLOTS - 1);
+
+        schema->hashes[i] = hash;
+        schema->slots[slot] = (uint8_t)(i + 1);
+    }
+
+    schema->ready = 1;
+}
+
+
+/*
+ * Функция поиска поля по ключу объекта
+ *
+ * Входные данные:
+ *  schema - описание записи
+ *  key    - ключ (без завершающего нуля)
+ *  length - длина ключа
+ *  hash   - хеш ключа (json_hash_string)
+ *
+ * Возвращаемое значение:
+ *  номер поля либо -1, если ключ не описан
+ */
+static int vc_schema_find (const vc_schema_t *schema, const char *key, size_t length, uint32_t hash)
+{
+    size_t slot = hash & (VC_SCHEMA_SLOTS - 1);
+
+    while (schema->slots[slot] != 0)
+    {
+        int index = schema->slots[slot] - 1;
+        const char *name = schema->fields[index].key;
+
+        if (schema->hashes[index] == hash && strlen(name) == length && memcmp(name, key, length) == 0)
+        {
+            return index;
+        }
+
+        slot = (slot + 1) & (VC_SCHEMA_SLOTS - 1);
+    }
+
+    return -1;
+}
+
+
+/*
+ * Функция декодирования значения поля в структуру
+ *
+ * Входные данные:
+ *  field  - описание поля
+ *  value  - значение из JSON
+ *  record - указатель на заполняемую структуру
+ *
+ * Возвращаемое значение:
+ *  1 - значение корректно и записано, иначе 0
+ */
+static int vc_decode_field (const vc_field_t *field, const json_value *value, void *record)
+{
+    char *target = (char *)record + field->offset;
+
+    switch (field->kind)
+    {
+    case VC_FIELD_U32:
+    {
+        return json_value_to_uint32(value, (uint32_t *)target);
+    }
+
+    case VC_FIELD_ACTIVE:
+    {
+        *(uint8_t *)target = json_value_is_string(value, "ON") ? VC_ON : VC_OFF;
+        return 1;
+    }
+
+    case VC_FIELD_COMMENT:
+    {
+        size_t comment_length = 0;
+        const char *comment = json_value_to_string_view(value, &comment_length);
+        snprintf(target, field->size, "\n# %.*s\n", (int)comment_length, comment ? comment : "");
+        return 1;
+    }
+
+    case VC_FIELD_STRING:
+    {
+        size_t length = 0;
+        const char *string = json_value_to_string_view(value, &length);
+
+        if (string == NULL)
+            return 0;
+
+        if (length > field->size - 1)
+            length = field->size - 1;
+
+        memset(target, 0, field->size);
+        memcpy(target, string, length);
+        return 1;
+    }
+
+    case VC_FIELD_ENUM:
+    case VC_FIELD_CHANNEL_TYPE:
+    {
+        const vc_enum_t *item = field->values;
+
+        while (item->name != NULL && !json_value_is_string(value, item->name))
+            item++;
+
+        if (item->name == NULL)
+            return 0;
+
+        *(uint8_t *)target = item->code;
+
+#ifndef ETHERNET_MODE
+        // Проверка, что дублирование AB отключено для ASM
+        if (field->kind == VC_FIELD_CHANNEL_TYPE && item->code == VC_ASM)
+        {
+            uint8_t *duplication = (uint8_t *)record + field->link_offset;
+
+            if (*duplication == VC_DUPLICATION_AB)
+                *duplication = VC_DUPLICATION_A;
+        }
+#endif
+        return 1;
+    }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Функция заполнения структуры из найденных значений полей. Поля декодируются в порядке
+ * описания до первого отсутствующего обязательного или некорректного
+ *
+ * Входные данные:
+ *  schema - описание записи
+ *  found  - значения полей по номерам описания, NULL - ключ отсутствует
+ *  record - указатель на заполняемую структуру
+ *
+ * Возвращаемое значение:
+ *  1 - все поля прочитаны, 0 - запись некорректна
+ */
+static int vc_bind_fields (const vc_schema_t *schema, const json_value * const *found, void *record)
+{
+    size_t i = 0;
+
+    for (i = 0; i < schema->count; i++)
+    {
+        const vc_field_t *field = &schema->fields[i];
+
+        if (found[i] == NULL)
+        {
+            if (field->flags & VC_REQUIRED)
+                return 0;
+
+            continue;
+        }
+
+        if (!vc_decode_field(field, found[i], record))
+            return 0;
+    }
+
+    return 1;
+}
+
+
+/*
+ * Функция заполнения структуры из объекта JSON за один проход по его парам. Значения
+ * сопоставляются полям по ключу (при повторе ключа используется первое)
+ *
+ * Входные данные:
+ *  schema - описание записи
+ *  object - объект JSON
+ *  record - указатель на заполняемую структуру
+ *
+ * Возвращаемое значение:
+ *  1 - все поля прочитаны, 0 - запись некорректна
+ */
+static int vc_bind_object (const vc_schema_t *schema, const json_value *object, void *record)
+{
+    const json_value *found[VC_SCHEMA_MAX_FIELDS] = { NULL };
+    size_t i = 0;
+
+    if (object->type != TYPE_OBJECT)
+        return 0;
+
+    const json_value *data = (const json_value *)object->value.object.data;
+    size_t size = object->value.object.size;
+
+    for (i = 0; i < size; i += 2)
+    {
+        const json_value *key = &data[i];
+        int index = vc_schema_find(schema, key->value.string.data, key->value.string.length, key->value.string.hash);
+
+        if (index >= 0 && found[index] == NULL)
+            found[index] = &data[i + 1];
+    }
+
+    return vc_bind_fields(schema, found, record);
+}
+
+
+// Минимальное число записей REGULAR_CONFIG на один поток преобразования
+#define FC_PARALLEL_MIN_ENTRIES     1024
+// Максимальное число потоков преобразования
+#define FC_PARALLEL_MAX_THREADS     256
+
+// Задание потока преобразования: диапазон записей REGULAR_CONFIG [begin, end)
+typedef struct
+{
+    const json_value *entries;      // элементы массива REGULAR_CONFIG
+    vc_regular_data_t *records;     // массив структур ВК
+    size_t begin;
+    size_t end;
+    uint32_t enabled_count;         // число корректных ВК в диапазоне
+} fc_regular_job_t;
+
+
+/*
+ * Функция заполнения структур ВК регулярного сообщения для диапазона записей. Каждый поток
+ * пишет только в свои элементы массива и свой счетчик, дерево разбора только читается
+ *
+ * Входные данные:
+ *  arg - задание (fc_regular_job_t)
+ *
+ * Возвращаемое значение:
+ *  NULL
+ */
+static void *fc_regular_worker (void *arg)
+{
+    fc_regular_job_t *job = arg;
+    size_t i = 0;
+
+    for (i = job->begin; i < job->end; i++)
+    {
+        vc_regular_data_t *vc = &job->records[i];
+
+        if (vc_bind_object(&vc_regular_schema, &job->entries[i], vc))
+        {
+            // Увеличение счетчика корректных ВК регулярного сообщения
+            job->enabled_count++;
+        }
+        else
+        {
+            vc->enabled = VC_OFF;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Функция заполнения структуры настроек из разобранного JSON-файла
+ *
+ * Входные данные:
+ *  root     - корневой объект JSON-файла
+ *  settings - структура настроек (выходной параметр)
+ *  threads  - число потоков для записей REGULAR_CONFIG (1 - без дополнительных потоков)
+ *
+ * Возвращаемое значение:
+ *  SUCCESS или DEF_ERROR при ошибке выделения памяти
+ */
+int fc_settings_from_json (const json_value *root, fc_settings_t *settings, int threads)
+{
+    size_t i = 0;
+
+    memset(settings, 0, sizeof(*settings));
+    settings->periodical_state = VC_OFF;
+
+    vc_schema_init(&vc_regular_schema);
+    vc_schema_init(&vc_periodical_schema);
+
+    JSON_STATS_BEGIN(JSON_STATS_REGULAR);
+
+    // Поиск узла REGULAR_CONFIG
+    json_value *regular_root = json_value_with_key(root, "REGULAR_CONFIG");
+
+    if (regular_root != NULL && regular_root->type == TYPE_ARRAY && regular_root->value.array.size > 0)
+    {
+        // Заполнение общего числа строк
+        settings->regular_overall_count = regular_root->value.array.size;
+
+        // Выделение памяти под массив структур ВК регулярного сообщения
+        settings->vc_regular_array = (vc_regular_data_t *)calloc(regular_root->value.array.size, sizeof(vc_regular_data_t));
+
+        if (settings->vc_regular_array == NULL)
+        {
+            JSON_STATS_END(JSON_STATS_REGULAR, 0, 0);
+            return DEF_ERROR;
+        }
+
+        // Записи делятся на непрерывные диапазоны по числу потоков, первый обрабатывается текущим потоком
+        size_t count = regular_root->value.array.size;
+        size_t jobs_count = (threads > 1) ? (size_t)threads : 1;
+
+        if (jobs_count > FC_PARALLEL_MAX_THREADS)
+            jobs_count = FC_PARALLEL_MAX_THREADS;
+
+        if (jobs_count > count / FC_PARALLEL_MIN_ENTRIES)
+            jobs_count = (count / FC_PARALLEL_MIN_ENTRIES > 0) ? count / FC_PARALLEL_MIN_ENTRIES : 1;
+
+        fc_regular_job_t jobs[FC_PARALLEL_MAX_THREADS];
+        pthread_t workers[FC_PARALLEL_MAX_THREADS];
+        int started[FC_PARALLEL_MAX_THREADS] = { 0 };
+
+        for (i = 0; i < jobs_count; i++)
+        {
+            jobs[i].entries = (const json_value *)regular_root->value.array.data;
+            jobs[i].records = settings->vc_regular_array;
+            jobs[i].begin = count * i / jobs_count;
+            jobs[i].end = count * (i + 1) / jobs_count;
+            jobs[i].enabled_count = 0;
+        }
+
+        // Парсинг файла конфигурации и заполнение структур. Если поток не создан, его диапазон
+        // обрабатывается текущим потоком
+        for (i = 1; i < jobs_count; i++)
+            started[i] = (pthread_create(&workers[i], NULL, fc_regular_worker, &jobs[i]) == 0);
+
+        fc_regular_worker(&jobs[0]);
+
+        for (i = 1; i < jobs_count; i++)
+        {
+            if (started[i])
+                pthread_join(workers[i], NULL);
+            else
+                fc_regular_worker(&jobs[i]);
+        }
+
+        // Сумма счетчиков не зависит от порядка завершения потоков
+        for (i = 0; i < jobs_count; i++)
+            settings->regular_enabled_count += jobs[i].enabled_count;
+    }
+
+    JSON_STATS_END(JSON_STATS_REGULAR, settings->regular_overall_count * sizeof(vc_regular_data_t),
+                   settings->regular_overall_count);
+    JSON_STATS_BEGIN(JSON_STATS_PERIODICAL);
+
+    // Поиск узла PERIODICAL_CONFIG
+    json_value *periodical_root = json_value_with_key(root, "PERIODICAL_CONFIG");
+
+    if (periodical_root != NULL && periodical_root->type == TYPE_ARRAY && periodical_root->value.array.size == 1)
+    {
+        json_value *periodical_vc = json_value_at(periodical_root, 0);
+
+        // Проверка включения ВК
+        json_value *value = json_value_with_key(periodical_vc, "active");
+
+        if (value != NULL && json_value_is_string(value, "ON"))
+        {
+#ifdef ETHERNET_MODE
+            settings->vc_periodical_array.enabled = VC_ON;
+#endif
+            if (vc_bind_object(&vc_periodical_schema, periodical_vc, &settings->vc_periodical_array))
+                settings->periodical_state = VC_ON;
+        }
+    }
+
+    JSON_STATS_END(JSON_STATS_PERIODICAL, sizeof(settings->vc_periodical_array), settings->periodical_state == VC_ON);
+
+#ifndef ETHERNET_MODE
+#ifndef GREK_FCRT
+    JSON_STATS_BEGIN(JSON_STATS_COMMON);
+
+    // Поиск узла COMMON_CONFIG
+    json_value *config_root = json_value_with_key(root, "COMMON_CONFIG");
+
+    if (config_root != NULL && config_root->type == TYPE_ARRAY)
+    {
+        for (i = 0; i < config_root->value.array.size; i++)
+        {
+            json_value *common_config = json_value_at(config_root, i);
+            json_value *name = json_value_with_key(common_config, "name");
+            json_value *value = json_value_with_key(common_config, "value");
+
+            if (name == NULL || value == NULL)
+                continue;
+
+            if (json_value_is_string(name, "pause"))
+                json_value_to_uint32(value, &settings->reset_pause);
+            else if (json_value_is_string(name, "fc_rx_err_delay"))
+                json_value_to_uint32(value, &settings->deep_filter);
+        }
+    }
+
+    JSON_STATS_END(JSON_STATS_COMMON, 0, (config_root != NULL && config_root->type == TYPE_ARRAY) ? config_root->value.array.size : 0);
+#endif
+#endif
+
+    return SUCCESS;
+}
+
+
+/*
+ * Функция заполнения структуры из объекта ленты за один проход по его парам (аналог
+ * vc_bind_object)
+ *
+ * Входные данные:
+ *  schema - описание записи
+ *  tape   - лента
+ *  object - объект ленты
+ *  record - указатель на заполняемую структуру
+ *
+ * Возвращаемое значение:
+ *  1 - все поля прочитаны, 0 - запись некорректна
+ */
+static int vc_bind_tape_object (const vc_schema_t *schema, const json_tape *tape, const json_tape_token *object, void *record)
+{
+    json_value values[VC_SCHEMA_MAX_FIELDS];
+    const json_value *found[VC_SCHEMA_MAX_FIELDS] = { NULL };
+    size_t i = 0;
+
+    if (object == NULL || object->type != TYPE_OBJECT)
+        return 0;
+
+    const json_tape_token *key = object + 1;
+
+    for (i = 0; i < object->length; i++)
+    {
+        int index = vc_schema_find(schema, tape->strings + key->value.string.offset, key->length, key->value.string.hash);
+
+        if (index >= 0 && found[index] == NULL)
+        {
+            json_tape_value(tape, key + 1, &values[index]);
+            found[index] = &values[index];
+        }
+
+        key = json_tape_next(key + 1);
+    }
+
+    return vc_bind_fields(schema, found, record);
+}
+
+
+/*
+ * Функция заполнения структуры настроек из документа в виде ленты. Результат совпадает
+ * с fc_settings_from_json
+ *
+ * Входные данные:
+ *  tape     - лента разобранного JSON-файла
+ *  settings - структура настроек (выходной параметр)
+ *
+ * Возвращаемое значение:
+ *  SUCCESS или DEF_ERROR при ошибке выделения памяти
+ */
+int fc_settings_from_tape (const json_tape *tape, fc_settings_t *settings)
+{
+    const json_tape_token *root = json_tape_root(tape);
+    size_t i = 0;
+
+    memset(settings, 0, sizeof(*settings));
+    settings->periodical_state = VC_OFF;
+
+    vc_schema_init(&vc_regular_schema);
+    vc_schema_init(&vc_periodical_schema);
+
+    // Поиск узла REGULAR_CONFIG
+    const json_tape_token *regular_root = json_tape_with_key(tape, root, "REGULAR_CONFIG");
+
+    if (regular_root != NULL && regular_root->type == TYPE_ARRAY && regular_root->length > 0)
+    {
+        settings->regular_overall_count = regular_root->length;
+        settings->vc_regular_array = (vc_regular_data_t *)calloc(regular_root->length, sizeof(vc_regular_data_t));
+
+        if (settings->vc_regular_array == NULL)
+            return DEF_ERROR;
+
+        // Записи лежат на ленте подряд, переход к следующей - одно сложение
+        const json_tape_token *entry = regular_root + 1;
+
+        for (i = 0; i < regular_root->length; i++)
+        {
+            vc_regular_data_t *vc = &settings->vc_regular_array[i];
+
+            if (vc_bind_tape_object(&vc_regular_schema, tape, entry, vc))
+                settings->regular_enabled_count++;
+            else
+                vc->enabled = VC_OFF;
+
+            entry = json_tape_next(entry);
+        }
+    }
+
+    // Поиск узла PERIODICAL_CONFIG
+    const json_tape_token *periodical_root = json_tape_with_key(tape, root, "PERIODICAL_CONFIG");
+
+    if (periodical_root != NULL && periodical_root->type == TYPE_ARRAY && periodical_root->length == 1)
+    {
+        const json_tape_token *periodical_vc = json_tape_at(periodical_root, 0);
+        const json_tape_token *active = json_tape_with_key(tape, periodical_vc, "active");
+        json_value value;
+
+        if (active != NULL)
+            json_tape_value(tape, active, &value);
+
+        if (active != NULL && json_value_is_string(&value, "ON"))
+        {
+#ifdef ETHERNET_MODE
+            settings->vc_periodical_array.enabled = VC_ON;
+#endif
+            if (vc_bind_tape_object(&vc_periodical_schema, tape, periodical_vc, &settings->vc_periodical_array))
+                settings->periodical_state = VC_ON;
+        }
+    }
+
+#ifndef ETHERNET_MODE
+#ifndef GREK_FCRT
+    // Поиск узла COMMON_CONFIG
+    const json_tape_token *config_root = json_tape_with_key(tape, root, "COMMON_CONFIG");
+
+    if (config_root != NULL && config_root->type == TYPE_ARRAY)
+    {
+        const json_tape_token *common_config = config_root + 1;
+
+        for (i = 0; i < config_root->length; i++, common_config = json_tape_next(common_config))
+        {
+            const json_tape_token *name_token = json_tape_with_key(tape, common_config, "name");
+            const json_tape_token *value_token = json_tape_with_key(tape, common_config, "value");
+            json_value name;
+            json_value value;
+
+            if (name_token == NULL || value_token == NULL)
+                continue;
+
+            json_tape_value(tape, name_token, &name);
+            json_tape_value(tape, value_token, &value);
+
+            if (json_value_is_string(&name, "pause"))
+                json_value_to_uint32(&value, &settings->reset_pause);
+            else if (json_value_is_string(&name, "fc_rx_err_delay"))
+                json_value_to_uint32(&value, &settings->deep_filter);
+        }
+    }
+#endif
+#endif
+
+    return SUCCESS;
+}
+
+// Разделы файла настроек
+#define FC_SECTION_NONE         0
+#define FC_SECTION_REGULAR      1   // REGULAR_CONFIG
+#define FC_SECTION_PERIODICAL   2   // PERIODICAL_CONFIG
+#define FC_SECTION_COMMON       3   // COMMON_CONFIG
+
+// Глубина вложенности событий потокового разбора
+#define FC_DEPTH_ROOT           1   // пары корневого объекта
+#define FC_DEPTH_SECTION        2   // элементы массива раздела
+#define FC_DEPTH_RECORD         3   // пары элемента раздела
+
+// Состояние заполнения настроек из событий потокового разбора
+typedef struct
+{
+    fc_settings_t *settings;
+    size_t regular_capacity;            // выделено элементов vc_regular_array
+    int depth;                          // текущая глубина вложенности
+    int pending;                        // раздел, ключ которого разобран последним на уровне корня
+    int section;                        // раздел, массив которого разбирается
+    int seen;                           // разделы, уже встреченные в корне (учитывается первый)
+    int record;                         // разбирается объект-элемент раздела
+    int field;                          // номер поля для следующего значения, -1 - значение не нужно
+    size_t elements;                    // число элементов массива текущего раздела
+    int out_of_memory;
+    int copy_strings;                   // строки событий временные (разбор по частям) и копируются в strings
+    json_arena strings;                 // копии строк текущего элемента
+
+    // Значения полей текущего элемента (строки указывают во входной буфер)
+    const vc_schema_t *schema;
+    json_value values[VC_SCHEMA_MAX_FIELDS + 2];
+    const json_value *found[VC_SCHEMA_MAX_FIELDS + 2];
+} fc_sax_state_t;
+
+// Номера вспомогательных значений после полей описания
+#define FC_SAX_ACTIVE           (VC_SCHEMA_MAX_FIELDS)      // "active" периодического сообщения
+#define FC_SAX_NAME             0                           // "name" элемента COMMON_CONFIG
+#define FC_SAX_VALUE            1                           // "value" элемента COMMON_CONFIG
+
+
+/*
+ * Функция завершения элемента раздела: запись ВК регулярного сообщения заполняется сразу,
+ * периодическое сообщение - после закрытия массива (должен быть ровно один элемент)
+ *
+ * Входные данные:
+ *  state     - состояние заполнения
+ *  is_object - элемент является объектом
+ *
+ * Возвращаемое значение:
+ *  1 - успешно, 0 - ошибка выделения памяти
+ */
+static int fc_sax_end_element (fc_sax_state_t *state, int is_object)
+{
+    fc_settings_t *settings = state->settings;
+
+    state->elements++;
+
+    if (state->section == FC_SECTION_REGULAR)
+    {
+        if (settings->regular_overall_count == state->regular_capacity)
+        {
+            size_t capacity = state->regular_capacity ? state->regular_capacity * 2 : 64;
+            vc_regular_data_t *array = realloc(settings->vc_regular_array, capacity * sizeof(vc_regular_data_t));
+
+            if (array == NULL)
+            {
+                state->out_of_memory = 1;
+                return 0;
+            }
+
+            settings->vc_regular_array = array;
+            state->regular_capacity = capacity;
+        }
+
+        vc_regular_data_t *vc = &settings->vc_regular_array[settings->regular_overall_count++];
+        memset(vc, 0, sizeof(*vc));
+
+        if (is_object && vc_bind_fields(&vc_regular_schema, state->found, vc))
+        {
+            // Увеличение счетчика корректных ВК регулярного сообщения
+            settings->regular_enabled_count++;
+        }
+        else
+        {
+            vc->enabled = VC_OFF;
+        }
+    }
+#ifndef ETHERNET_MODE
+#ifndef GREK_FCRT
+    else if (state->section == FC_SECTION_COMMON && is_object)
+    {
+        const json_value *name = state->found[FC_SAX_NAME];
+        const json_value *value = state->found[FC_SAX_VALUE];
+
+        if (name != NULL && value != NULL)
+        {
+            if (json_value_is_string(name, "pause"))
+                json_value_to_uint32(value, &settings->reset_pause);
+            else if (json_value_is_string(name, "fc_rx_err_delay"))
+                json_value_to_uint32(value, &settings->deep_filter);
+        }
+    }
+#endif
+#endif
+
+    return 1;
+}
+
+
+/*
+ * Функция обработки значения: на уровне раздела - элемент, не являющийся объектом,
+ * на уровне элемента - значение поля
+ *
+ * Входные данные:
+ *  state - состояние заполнения
+ *  value - значение (для массивов и объектов - пустой узел соответствующего типа)
+ *
+ * Возвращаемое значение:
+ *  1 - продолжать разбор, 0 - прервать
+ */
+static int fc_sax_value (fc_sax_state_t *state, const json_value *value)
+{
+    if (state->section != FC_SECTION_NONE && state->depth == FC_DEPTH_SECTION)
+        return fc_sax_end_element(state, 0);
+
+    if (state->record && state->depth == FC_DEPTH_RECORD && state->field >= 0)
+    {
+        state->values[state->field] = *value;
+
+        if (value->type == TYPE_STRING && state->copy_strings)
+        {
+            size_t length = value->value.string.length;
+            char *copy = json_arena_alloc(&state->strings, length + 1);
+
+            if (copy == NULL)
+            {
+                state->out_of_memory = 1;
+                return 0;
+            }
+
+            memcpy(copy, value->value.string.data, length);
+            copy[length] = '\0';
+            state->values[state->field].value.string.data = copy;
+        }
+
+        state->found[state->field] = &state->values[state->field];
+        state->field = -1;
+    }
+
+    return 1;
+}
+
+
+static int fc_sax_on_null (void *context)
+{
+    json_value value = { .type = TYPE_NULL };
+
+    return fc_sax_value(context, &value);
+}
+
+
+static int fc_sax_on_bool (void *context, int boolean)
+{
+    json_value value = { .type = TYPE_BOOL, .value.boolean = boolean };
+
+    return fc_sax_value(context, &value);
+}
+
+
+static int fc_sax_on_integer (void *context, int64_t integer)
+{
+    json_value value = { .type = TYPE_INTEGER, .value.integer = integer };
+
+    return fc_sax_value(context, &value);
+}
+
+
+static int fc_sax_on_number (void *context, double number)
+{
+    json_value value = { .type = TYPE_NUMBER, .value.number = number };
+
+    return fc_sax_value(context, &value);
+}
+
+
+static int fc_sax_on_string (void *context, const char *data, size_t length)
+{
+    json_value value = { .type = TYPE_STRING, .flags = JSON_FLAG_BORROWED };
+
+    value.value.string.data = (char *)data;
+    value.value.string.length = length;
+
+    return fc_sax_value(context, &value);
+}
+
+
+/*
+ * Функция обработки ключа: в корне выбирается раздел, в элементе раздела - поле
+ * (при повторе ключа используется первое значение)
+ */
+static int fc_sax_on_key (void *context, const char *data, size_t length, uint32_t hash)
+{
+    fc_sax_state_t *state = context;
+    int index = -1;
+
+    if (state->depth == FC_DEPTH_ROOT)
+    {
+        int section = FC_SECTION_NONE;
+
+        if (length == 14 && memcmp(data, "REGULAR_CONFIG", 14) == 0)
+            section = FC_SECTION_REGULAR;
+        else if (length == 17 && memcmp(data, "PERIODICAL_CONFIG", 17) == 0)
+            section = FC_SECTION_PERIODICAL;
+#ifndef ETHERNET_MODE
+#ifndef GREK_FCRT
+        else if (length == 13 && memcmp(data, "COMMON_CONFIG", 13) == 0)
+            section = FC_SECTION_COMMON;
+#endif
+#endif
+
+        if (section != FC_SECTION_NONE && (state->seen & (1 << section)) == 0)
+        {
+            state->seen |= (1 << section);
+            state->pending = section;
+        }
+        else
+        {
+            state->pending = FC_SECTION_NONE;
+        }
+
+        return 1;
+    }
+
+    if (!state->record || state->depth != FC_DEPTH_RECORD)
+        return 1;
+
+    if (state->section == FC_SECTION_COMMON)
+    {
+        if (length == 4 && memcmp(data, "name", 4) == 0)
+            index = FC_SAX_NAME;
+        else if (length == 5 && memcmp(data, "value", 5) == 0)
+            index = FC_SAX_VALUE;
+    }
+    else
+    {
+        index = vc_schema_find(state->schema, data, length, hash);
+
+        if (index < 0 && state->section == FC_SECTION_PERIODICAL && length == 6 && memcmp(data, "active", 6) == 0)
+            index = FC_SAX_ACTIVE;
+    }
+
+    state->field = (index >= 0 && state->found[index] == NULL) ? index : -1;
+
+    return 1;
+}
+
+
+static int fc_sax_on_object_begin (void *context)
+{
+    fc_sax_state_t *state = context;
+    json_value value = { .type = TYPE_OBJECT };
+    int success = 1;
+
+    if (state->section != FC_SECTION_NONE && state->depth == FC_DEPTH_SECTION &&
+        (state->section != FC_SECTION_PERIODICAL || state->elements == 0))
+    {
+        // Начало элемента раздела (для периодического сообщения учитывается только первый)
+        state->record = 1;
+        state->field = -1;
+        memset(state->found, 0, sizeof(state->found));
+
+        if (state->copy_strings)
+            json_arena_reset(&state->strings);
+    }
+    else if (!(state->section == FC_SECTION_PERIODICAL && state->depth == FC_DEPTH_SECTION))
+    {
+        success = fc_sax_value(state, &value);
+    }
+
+    state->depth++;
+
+    return success;
+}
+
+
+static int fc_sax_on_object_end (void *context)
+{
+    fc_sax_state_t *state = context;
+
+    state->depth--;
+
+    if (state->section != FC_SECTION_NONE && state->depth == FC_DEPTH_SECTION)
+    {
+        int is_object = state->record;
+
+        state->record = 0;
+
+        return fc_sax_end_element(state, is_object);
+    }
+
+    return 1;
+}
+
+
+static int fc_sax_on_array_begin (void *context)
+{
+    fc_sax_state_t *state = context;
+    json_value value = { .type = TYPE_ARRAY };
+    int success = 1;
+
+    if (state->depth == FC_DEPTH_ROOT && state->pending != FC_SECTION_NONE)
+    {
+        state->section = state->pending;
+        state->elements = 0;
+        state->schema = (state->section == FC_SECTION_REGULAR) ? &vc_regular_schema : &vc_periodical_schema;
+        memset(state->found, 0, sizeof(state->found));
+    }
+    else
+    {
+        success = fc_sax_value(state, &value);
+    }
+
+    state->depth++;
+
+    return success;
+}
+
+
+static int fc_sax_on_array_end (void *context)
+{
+    fc_sax_state_t *state = context;
+    fc_settings_t *settings = state->settings;
+
+    state->depth--;
+
+    if (state->section == FC_SECTION_NONE || state->depth != FC_DEPTH_ROOT)
+        return 1;
+
+    // Периодическое сообщение: ровно один элемент-объект с "active": "ON"
+    const json_value *active = state->found[FC_SAX_ACTIVE];
+
+    if (state->section == FC_SECTION_PERIODICAL && state->elements == 1 &&
+        active != NULL && json_value_is_string(active, "ON"))
+    {
+#ifdef ETHERNET_MODE
+        settings->vc_periodical_array.enabled = VC_ON;
+#endif
+        if (vc_bind_fields(&vc_periodical_schema, state->found, &settings->vc_periodical_array))
+            settings->periodical_state = VC_ON;
+    }
+
+    state->section = FC_SECTION_NONE;
+    state->pending = FC_SECTION_NONE;
+
+    return 1;
+}
+
+
+// Обработчики событий для заполнения структуры настроек
+static const json_sax_handler fc_sax_handler = {
+    .on_null = fc_sax_on_null,
+    .on_bool = fc_sax_on_bool,
+    .on_integer = fc_sax_on_integer,
+    .on_number = fc_sax_on_number,
+    .on_string = fc_sax_on_string,
+    .on_key = fc_sax_on_key,
+    .on_object_begin = fc_sax_on_object_begin,
+    .on_object_end = fc_sax_on_object_end,
+    .on_array_begin = fc_sax_on_array_begin,
+    .on_array_end = fc_sax_on_array_end,
+};
+
+
+/*
+ * Функция подготовки состояния заполнения настроек
+ *
+ * Входные данные:
+ *  state    - состояние заполнения
+ *  settings - структура настроек (выходной параметр)
+ */
+static void fc_sax_state_init (fc_sax_state_t *state, fc_settings_t *settings)
+{
+    memset(settings, 0, sizeof(*settings));
+    settings->periodical_state = VC_OFF;
+
+    memset(state, 0, sizeof(*state));
+    state->settings = settings;
+    state->field = -1;
+    json_arena_init(&state->strings, 0);
+
+    vc_schema_init(&vc_regular_schema);
+    vc_schema_init(&vc_periodical_schema);
+}
+
+
+/*
+ * Функция завершения заполнения настроек. При ошибке разбора заполненные данные освобождаются
+ *
+ * Входные данные:
+ *  state   - состояние заполнения
+ *  success - разбор завершен успешно
+ *
+ * Возвращаемое значение:
+ *  SUCCESS, DEF_ERROR при ошибке разбора, -ENOMEM при ошибке выделения памяти
+ */
+static int fc_sax_state_finish (fc_sax_state_t *state, int success)
+{
+    fc_settings_t *settings = state->settings;
+
+    json_arena_release(&state->strings);
+
+    if (success)
+        return SUCCESS;
+
+    free(settings->vc_regular_array);
+    settings->vc_regular_array = NULL;
+    settings->regular_overall_count = 0;
+    settings->regular_enabled_count = 0;
+
+    return state->out_of_memory ? -ENOMEM : DEF_ERROR;
+}
+
+
+/*
+ * Функция заполнения структуры настроек потоковым разбором с повторным использованием
+ * буферов разбора (пакетная обработка файлов)
+ *
+ * Входные данные:
+ *  input    - изменяемый массив с данными JSON файла
+ *  settings - структура настроек (выходной параметр)
+ *  scratch  - буферы разбора
+ *
+ * Возвращаемое значение:
+ *  SUCCESS, DEF_ERROR при ошибке разбора, -ENOMEM при ошибке выделения памяти
+ */
+int fc_settings_parse_scratch (char *input, fc_settings_t *settings, json_scratch *scratch)
+{
+    fc_sax_state_t state;
+
+    fc_sax_state_init(&state, settings);
+
+    return fc_sax_state_finish(&state, json_parse_sax_scratch(input, &fc_sax_handler, &state, scratch));
+}
+
+
+/*
+ * Функция заполнения структуры настроек потоковым разбором JSON-файла (без построения дерева).
+ * Результат совпадает с json_parse и fc_settings_from_json
+ *
+ * Входные данные:
+ *  input    - изменяемый массив с данными JSON файла
+ *  settings - структура настроек (выходной параметр)
+ *
+ * Возвращаемое значение:
+ *  SUCCESS, DEF_ERROR при ошибке разбора, -ENOMEM при ошибке выделения памяти
+ */
+int fc_settings_parse (char *input, fc_settings_t *settings)
+{
+    return fc_settings_parse_scratch(input, settings, NULL);
+}
+
+
+/*
+ * Функция заполнения структуры настроек разбором по частям из файлового дескриптора
+ * (канал, stdin). Разбор идет по мере поступления данных, файл целиком не хранится
+ *
+ * Входные данные:
+ *  fd       - файловый дескриптор
+ *  settings - структура настроек (выходной параметр)
+ *
+ * Возвращаемое значение:
+ *  SUCCESS, DEF_ERROR при ошибке чтения или разбора, -ENOMEM при ошибке выделения памяти
+ */
+int fc_settings_parse_fd (int fd, fc_settings_t *settings)
+{
+    fc_sax_state_t state;
+    json_stream stream;
+    char chunk[65536];
+    int status = JSON_STREAM_NEED_MORE;
+
+    fc_sax_state_init(&state, settings);
+    state.copy_strings = 1;
+    json_stream_init(&stream, &fc_sax_handler, &state);
+
+    while (status == JSON_STREAM_NEED_MORE)
+    {
+        ssize_t got = read(fd, chunk, sizeof(chunk));
+
+        if (got < 0 && errno == EINTR)
+            continue;
+
+        if (got < 0)
+            status = JSON_STREAM_ERROR;
+        else if (got == 0)
+            status = json_stream_finish(&stream);
+        else
+            status = json_stream_feed(&stream, chunk, (size_t)got);
+    }
+
+    json_stream_free(&stream);
+
+    return fc_sax_state_finish(&state, status == JSON_STREAM_COMPLETE);
+}
+
+
+// Размер буфера записи файла cfg
+#define CFG_WRITER_BUFFER       65536
+// Запас буфера под одну строку cfg (13 чисел по 10 цифр, разделители и тип)
+#define CFG_WRITER_LINE_MAX     160
+
+// Буферизованная запись файла cfg: данные сбрасываются в файл блоками по CFG_WRITER_BUFFER
+typedef struct
+{
+    int fd;
+    int error;                      // ошибка записи, дальнейшие данные отбрасываются
+    size_t used;                    // занято байт в буфере
+    char buffer[CFG_WRITER_BUFFER];
+} cfg_writer_t;
+
+// Пары десятичных цифр 00..99 для форматирования чисел по два разряда
+static const char cfg_digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+
+/*
+ * Функция сброса буфера в файл
+ *
+ * Входные данные:
+ *  writer - буфер записи
+ *
+ * Возвращаемое значение:
+ *  SUCCESS или DEF_ERROR при ошибке записи
+ */
+static int cfg_writer_flush (cfg_writer_t *writer)
+{
+    const char *data = writer->buffer;
+    size_t left = writer->used;
+
+    while (!writer->error && left > 0)
+    {
+        ssize_t written = write(writer->fd, data, left);
+
+        if (written < 0 && errno == EINTR)
+            continue;
+
+        if (written <= 0)
+        {
+            writer->error = 1;
+            break;
+        }
+
+        data += written;
+        left -= (size_t)written;
+    }
+
+    writer->used = 0;
+
+    return writer->error ? DEF_ERROR : SUCCESS;
+}
+
+
+/*
+ * Функция резервирования места в буфере
+ *
+ * Входные данные:
+ *  writer - буфер записи
+ *  size   - требуемый размер (не больше CFG_WRITER_BUFFER)
+ *
+ * Возвращаемое значение:
+ *  указатель на свободное место буфера
+ */
+static inline char *cfg_writer_reserve (cfg_writer_t *writer, size_t size)
+{
+    if (CFG_WRITER_BUFFER - writer->used < size)
+        cfg_writer_flush(writer);
+
+    return writer->buffer + writer->used;
+}
+
+
+/*
+ * Функция добавления строки в буфер
+ *
+ * Входные данные:
+ *  writer - буфер записи
+ *  data   - данные
+ *  size   - размер данных
+ */
+static void cfg_writer_put (cfg_writer_t *writer, const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        size_t chunk = (size < CFG_WRITER_BUFFER) ? size : CFG_WRITER_BUFFER;
+
+        memcpy(cfg_writer_reserve(writer, chunk), data, chunk);
+        writer->used += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+
+/*
+ * Функция десятичной записи беззнакового числа (аналог "%u")
+ *
+ * Входные данные:
+ *  value - число
+ *  out   - буфер не меньше 10 байт
+ *
+ * Возвращаемое значение:
+ *  число записанных символов
+ */
+static size_t cfg_format_u32 (uint32_t value, char *out)
+{
+    char digits[10];
+    char *p = digits + sizeof(digits);
+
+    while (value >= 100)
+    {
+        uint32_t pair = (value % 100) * 2;
+
+        value /= 100;
+        p -= 2;
+        p[0] = cfg_digit_pairs[pair];
+        p[1] = cfg_digit_pairs[pair + 1];
+    }
+
+    if (value >= 10)
+    {
+        p -= 2;
+        p[0] = cfg_digit_pairs[value * 2];
+        p[1] = cfg_digit_pairs[value * 2 + 1];
+    }
+    else
+    {
+        *--p = (char)('0' + value);
+    }
+
+    size_t length = (size_t)(digits + sizeof(digits) - p);
+    memcpy(out, p, length);
+
+    return length;
+}
+
+
+/*
+ * Функция записи строки "<префикс>=<число>,<число>,...\n"
+ *
+ * Входные данные:
+ *  writer - буфер записи
+ *  prefix - символ перед '='
+ *  values - числа
+ *  count  - количество чисел (не больше 13)
+ */
+static void cfg_writer_line (cfg_writer_t *writer, char prefix, const uint32_t *values, size_t count)
+{
+    char *start = cfg_writer_reserve(writer, CFG_WRITER_LINE_MAX);
+    char *p = start;
+    size_t i = 0;
+
+    *p++ = prefix;
+    *p++ = '=';
+
+    for (i = 0; i < count; i++)
+    {
+        if (i > 0)
+            *p++ = ',';
+
+        p += cfg_format_u32(values[i], p);
+    }
+
+    *p++ = '\n';
+    writer->used += (size_t)(p - start);
+}
+
+
+/*
+ * Функция записи структуры настроек в открытый файл cfg через буфер записи
+ *
+ * Входные данные:
+ *  settings - структура настроек
+ *  writer   - буфер записи (writer->fd - дескриптор файла)
+ *
+ * Возвращаемое значение:
+ *  SUCCESS или DEF_ERROR при ошибке записи
+ */
+static int fc_settings_write_cfg_buffered (const fc_settings_t *settings, cfg_writer_t *writer)
+{
+    uint32_t i;
+    const vc_regular_data_t * rd = settings->vc_regular_array;
+    const vc_periodical_data_t * pd = &settings->vc_periodical_array;
+
+    writer->error = 0;
+    writer->used = 0;
+
+    ///обычные сообщения
+    for(i = 0; i < settings->regular_overall_count; i++, rd++)
+    {
+        uint32_t values[] = {
+            rd->dst_id, rd->src_id,
+            rd->input_port, rd->output_port,
+            rd->priority,
+            rd->input_asm_id, rd->output_asm_id,
+            rd->max_size,
+            rd->input_queue, rd->output_queue,
+            rd->duplication,
+            rd->channel_type,
+            rd->timeout_AB
+        };
+
+        cfg_writer_put(writer, rd->comment, strnlen(rd->comment, sizeof(rd->comment)));
+        if(rd->enabled == VC_OFF)
+            cfg_writer_put(writer, "#", 1);
+
+        // Нулевой тип (запись не заполнена) обрывал строку формата "%c=...", строка не пишется
+        if (rd->type != '\0')
+            cfg_writer_line(writer, rd->type, values, sizeof(values) / sizeof(values[0]));
+    }
+    ///статусное сообщение
+    uint32_t periodical_values[] = {
+        pd->dst_id, pd->src_id,
+        pd->output_port,
+        pd->period,
+        pd->output_asm_id,
+        pd->max_size,
+        pd->duplication,
+        pd->priority
+    };
+
+    cfg_writer_put(writer, pd->comment, strnlen(pd->comment, sizeof(pd->comment)));
+    cfg_writer_line(writer, 'P', periodical_values, sizeof(periodical_values) / sizeof(periodical_values[0]));
+
+    return cfg_writer_flush(writer);
+}
+
+
+/*
+ * Функция записи структуры настроек в файл cfg. Строки формируются без snprintf
+ * и записываются в файл блоками через буфер
+ *
+ * Входные данные:
+ *  settings  - структура настроек
+ *  dest_path - путь к файлу cfg
+ *
+ * Возвращаемое значение:
+ *  SUCCESS или DEF_ERROR, если файл не удалось открыть или записать
+ */
+int fc_settings_write_cfg (const fc_settings_t *settings, const char *dest_path)
+{
+    ///пишем данные в файл cfg
+    int cfg_fd = open(dest_path, O_CREAT | O_TRUNC | O_RDWR, S_IRWXU | S_IRWXG | S_IRWXO);
+    if(cfg_fd > 0)
+    {
+        cfg_writer_t *writer = malloc(sizeof(cfg_writer_t));
+        int result = DEF_ERROR;
+
+        if (writer != NULL)
+        {
+            writer->fd = cfg_fd;
+            result = fc_settings_write_cfg_buffered(settings, writer);
+            free(writer);
+        }
+
+        close(cfg_fd);
+
+        return result;
+    }
+    else
+    {
+        printf("\nError: could not open file\n");
+        return DEF_ERROR;
+    }
+}
+
+
+/*
+ * Функция освобождения памяти структуры настроек
+ *
+ * Входные данные:
+ *  settings - структура настроек
+ */
+void fc_settings_free (fc_settings_t *settings)
+{
+    free(settings->vc_regular_array);
+    settings->vc_regular_array = NULL;
+}
+
+
+/*
+ * Функция заполнения структуры настроек через дерево разбора в арене. Используется
+ * для многопоточного преобразования записей REGULAR_CONFIG
+ *
+ * Входные данные:
+ *  input    - изменяемый массив с данными JSON файла
+ *  size     - размер данных
+ *  settings - структура настроек (выходной параметр)
+ *  threads  - число потоков преобразования
+ *
+ * Возвращаемое значение:
+ *  SUCCESS, DEF_ERROR при ошибке разбора, -ENOMEM при ошибке выделения памяти
+ */
+static int fc_settings_parse_tree (char *input, size_t size, fc_settings_t *settings, int threads)
+{
+    json_value root;
+    json_arena arena;
+    int result = DEF_ERROR;
+
+    json_arena_init(&arena, size);
+
+    JSON_STATS_BEGIN(JSON_STATS_PARSE);
+    int parsed = json_parse_arena_parallel(input, &root, &arena, JSON_PARSE_IN_SITU, threads);
+    JSON_STATS_END(JSON_STATS_PARSE, size, 0);
+
+    if (parsed == 1)
+    {
+        JSON_STATS_NODES(&root);
+        result = (fc_settings_from_json(&root, settings, threads) == SUCCESS) ? SUCCESS : -ENOMEM;
+    }
+
+    JSON_STATS_BEGIN(JSON_STATS_FREE);
+    json_arena_release(&arena);
+    JSON_STATS_END(JSON_STATS_FREE, 0, 0);
+
+    return result;
+}
+
+
+// Режим сборки в ключе кеша: результат преобразования зависит от набора полей
+#if defined(ETHERNET_MODE) && defined(GREK_FCRT)
+#define FC_BUILD_MODE           "ethernet-grek"
+#elif defined(ETHERNET_MODE)
+#define FC_BUILD_MODE           "ethernet"
+#elif defined(GREK_FCRT)
+#define FC_BUILD_MODE           "grek"
+#else
+#define FC_BUILD_MODE           "default"
+#endif
+
+// Версия формата cfg в ключе кеша (увеличивается при изменении вывода)
+#define FC_CACHE_VERSION        1
+
+// Кеш результатов преобразования: файлы cfg по хешу входных данных
+typedef struct
+{
+    const char *dir;            // каталог кеша
+    size_t hits;                // число попаданий
+    size_t misses;              // число промахов
+} fc_cache_t;
+
+
+/*
+ * Функция 128-битного хеширования входных данных (не криптографическая, два независимых
+ * потока по 8 байт за шаг с перемешиванием умножением)
+ *
+ * Входные данные:
+ *  data - данные
+ *  size - размер
+ *  hash - результат (выходной параметр)
+ */
+static void fc_hash_input (const char *data, size_t size, uint64_t hash[2])
+{
+    const uint64_t k1 = 0x9E3779B97F4A7C15ULL;
+    const uint64_t k2 = 0xC2B2AE3D27D4EB4FULL;
+    uint64_t a = 0x243F6A8885A308D3ULL ^ (size * k1);
+    uint64_t b = 0x13198A2E03707344ULL ^ (size * k2);
+    size_t offset = 0;
+
+    for (offset = 0; offset + 16 <= size; offset += 16)
+    {
+        uint64_t w1;
+        uint64_t w2;
+
+        memcpy(&w1, data + offset, 8);
+        memcpy(&w2, data + offset + 8, 8);
+
+        a = (a ^ w1) * k1;
+        a ^= a >> 29;
+        b = (b ^ w2) * k2;
+        b ^= b >> 31;
+    }
+
+    if (offset < size)
+    {
+        uint64_t tail[2] = { 0, 0 };
+
+        memcpy(tail, data + offset, size - offset);
+        a = ((a ^ tail[0]) * k1) ^ (size - offset);
+        b = (b ^ tail[1]) * k2;
+    }
+
+    // Финальное перемешивание: каждая половина зависит от обоих потоков
+    a ^= b * k2;
+    b ^= a * k1;
+    a ^= a >> 33;
+    a *= 0xFF51AFD7ED558CCDULL;
+    a ^= a >> 33;
+    b ^= b >> 33;
+    b *= 0xC4CEB9FE1A85EC53ULL;
+    b ^= b >> 33;
+
+    hash[0] = a;
+    hash[1] = b;
+}
+
+
+/*
+ * Функция формирования пути файла кеша для входных данных
+ *
+ * Входные данные:
+ *  cache - кеш
+ *  data  - входные данные (до разбора на месте)
+ *  size  - размер данных
+ *  path  - путь (выходной параметр)
+ *  path_size - размер буфера пути
+ */
+static void fc_cache_path (const fc_cache_t *cache, const char *data, size_t size, char *path, size_t path_size)
+{
+    uint64_t hash[2];
+
+    fc_hash_input(data, size, hash);
+    snprintf(path, path_size, "%s/%s-v%d-%zx-%016llx%016llx.cfg", cache->dir, FC_BUILD_MODE, FC_CACHE_VERSION,
+             size, (unsigned long long)hash[0], (unsigned long long)hash[1]);
+}
+
+
+/*
+ * Функция формирования имени временного файла рядом с path (уникального для процесса и потока)
+ *
+ * Входные данные:
+ *  path      - путь к итоговому файлу
+ *  temp_path - путь к временному файлу (выходной параметр)
+ *  temp_size - размер буфера пути
+ */
+static void fc_temp_path (const char *path, char *temp_path, size_t temp_size)
+{
+    snprintf(temp_path, temp_size, "%s.%d.%lx.tmp", path, (int)getpid(), (unsigned long)pthread_self());
+}
+
+
+/*
+ * Функция копирования файла
+ *
+ * Входные данные:
+ *  src_path - исходный файл
+ *  dst_path - файл назначения (создается или перезаписывается)
+ *
+ * Возвращаемое значение:
+ *  SUCCESS или DEF_ERROR
+ */
+static int fc_copy_file (const char *src_path, const char *dst_path)
+{
+    char buffer[65536];
+    int result = SUCCESS;
+    int src = open(src_path, O_RDONLY);
+
+    if (src < 0)
+        return DEF_ERROR;
+
+    int dst = open(dst_path, O_CREAT | O_TRUNC | O_WRONLY, S_IRWXU | S_IRWXG | S_IRWXO);
+
+    if (dst < 0)
+    {
+        close(src);
+        return DEF_ERROR;
+    }
+
+    while (result == SUCCESS)
+    {
+        ssize_t got = read(src, buffer, sizeof(buffer));
+
+        if (got < 0 && errno == EINTR)
+            continue;
+
+        if (got <= 0)
+        {
+            result = (got == 0) ? SUCCESS : DEF_ERROR;
+            break;
+        }
+
+        char *p = buffer;
+
+        while (got > 0)
+        {
+            ssize_t written = write(dst, p, (size_t)got);
+
+            if (written < 0 && errno == EINTR)
+                continue;
+
+            if (written <= 0)
+            {
+                result = DEF_ERROR;
+                break;
+            }
+
+            p += written;
+            got -= written;
+        }
+    }
+
+    close(src);
+
+    if (close(dst) != 0)
+        result = DEF_ERROR;
+
+    return result;
+}
+
+
+/*
+ * Функция получения результата из кеша
+ *
+ * Входные данные:
+ *  cache      - кеш
+ *  cache_path - путь файла кеша
+ *  dest_path  - путь к файлу cfg
+ *
+ * Возвращаемое значение:
+ *  1 - результат найден и скопирован, иначе 0 (учитывается как промах)
+ */
+static int fc_cache_fetch (fc_cache_t *cache, const char *cache_path, const char *dest_path)
+{
+    int hit = (access(cache_path, R_OK) == 0 && fc_copy_file(cache_path, dest_path) == SUCCESS);
+
+    __atomic_fetch_add(hit ? &cache->hits : &cache->misses, 1, __ATOMIC_RELAXED);
+
+    return hit;
+}
+
+
+/*
+ * Функция сохранения результата в кеш. Файл записывается под временным именем и
+ * переименовывается, поэтому параллельные процессы не видят неполных файлов
+ *
+ * Входные данные:
+ *  cache_path - путь файла кеша
+ *  dest_path  - путь к записанному файлу cfg
+ */
+static void fc_cache_store (const char *cache_path, const char *dest_path)
+{
+    char temp_path[4096];
+
+    fc_temp_path(cache_path, temp_path, sizeof(temp_path));
+
+    if (fc_copy_file(dest_path, temp_path) != SUCCESS || rename(temp_path, cache_path) != 0)
+        unlink(temp_path);
+}
+
+
+/*
+ * Функция вывода статистики кеша
+ *
+ * Входные данные:
+ *  cache - кеш
+ */
+static void fc_cache_report (const fc_cache_t *cache)
+{
+    printf("cache: %zu hit, %zu miss\n", cache->hits, cache->misses);
+}
+
+
+#ifndef ETHERNET_MODE
+#ifndef GREK_FCRT
+// Бинарный образ настроек: заголовок, массив записей ВК регулярного сообщения, запись
+// периодического сообщения и раздел строк (комментарии с завершающими нулями). Записи имеют
+// фиксированный размер, все числа - беззнаковые little-endian, смещения - от начала образа
+#define FC_IMAGE_MAGIC              "FCSETIMG"
+#define FC_IMAGE_VERSION            1
+#define FC_IMAGE_HEADER_SIZE        64
+#define FC_IMAGE_REGULAR_SIZE       56
+#define FC_IMAGE_PERIODICAL_SIZE    40
+
+// Смещения полей заголовка
+#define FC_IMAGE_H_VERSION          8
+#define FC_IMAGE_H_HEADER_SIZE      12
+#define FC_IMAGE_H_REGULAR_SIZE     16
+#define FC_IMAGE_H_PERIODICAL_SIZE  20
+#define FC_IMAGE_H_OVERALL_COUNT    24
+#define FC_IMAGE_H_ENABLED_COUNT    28
+#define FC_IMAGE_H_RESET_PAUSE      32
+#define FC_IMAGE_H_DEEP_FILTER      36
+#define FC_IMAGE_H_PERIODICAL_STATE 40
+#define FC_IMAGE_H_REGULAR_OFFSET   48
+#define FC_IMAGE_H_PERIODICAL_OFFSET 52
+#define FC_IMAGE_H_STRINGS_OFFSET   56
+#define FC_IMAGE_H_STRINGS_SIZE     60
+
+// Отображенный в память образ настроек с проверенными границами разделов
+typedef struct
+{
+    json_input input;
+    const uint8_t *data;
+    uint32_t regular_count;
+    uint32_t regular_size;      // шаг записей (не меньше FC_IMAGE_REGULAR_SIZE)
+    uint32_t regular_offset;
+    uint32_t periodical_size;
+    uint32_t periodical_offset;
+    uint32_t strings_offset;
+    uint32_t strings_size;
+} fc_image_t;
+
+
+/*
+ * Функции записи и чтения 32-битного числа little-endian
  */
-static void skip_whitespace (const char **cursor)
+static inline void fc_image_put_u32 (uint8_t *p, uint32_t value)
 {
-    if (**cursor == '\0')
-        return;
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
 
-    while (iscntrl(**cursor) || isspace(**cursor))
-        ++(*cursor);
+static inline uint32_t fc_image_get_u32 (const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
 }
 
 
 /*
- * Функция проверки наличия символа в строке
+ * Функция записи структуры настроек в бинарный образ
  *
  * Входные данные:
- *  cursor    - указатель на позицию в массиве с данными JSON файла
- *  character - символ
+ *  settings   - структура настроек
+ *  image_path - путь к файлу образа
  *
  * Возвращаемое значение:
- *  положительное значение при наличии символа, иначе 0
+ *  SUCCESS или DEF_ERROR, если файл не удалось открыть или записать либо образ больше 4 ГБ
  */
-static int has_char (const char **cursor, char character)
+int fc_settings_write_image (const fc_settings_t *settings, const char *image_path)
 {
-    skip_whitespace(cursor);
-    int success = (**cursor == character);
+    const vc_periodical_data_t *pd = &settings->vc_periodical_array;
+    uint8_t header[FC_IMAGE_HEADER_SIZE];
+    uint64_t strings_size = strnlen(pd->comment, sizeof(pd->comment)) + 1;
+    uint32_t i = 0;
 
-    if (success)
-        ++(*cursor);
+    for (i = 0; i < settings->regular_overall_count; i++)
+        strings_size += strnlen(settings->vc_regular_array[i].comment, sizeof(settings->vc_regular_array[i].comment)) + 1;
 
-    return success;
+    uint64_t regular_offset = FC_IMAGE_HEADER_SIZE;
+    uint64_t periodical_offset = regular_offset + (uint64_t)settings->regular_overall_count * FC_IMAGE_REGULAR_SIZE;
+    uint64_t strings_offset = periodical_offset + FC_IMAGE_PERIODICAL_SIZE;
+
+    if (strings_offset + strings_size > UINT32_MAX)
+        return DEF_ERROR;
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, FC_IMAGE_MAGIC, 8);
+    fc_image_put_u32(header + FC_IMAGE_H_VERSION, FC_IMAGE_VERSION);
+    fc_image_put_u32(header + FC_IMAGE_H_HEADER_SIZE, FC_IMAGE_HEADER_SIZE);
+    fc_image_put_u32(header + FC_IMAGE_H_REGULAR_SIZE, FC_IMAGE_REGULAR_SIZE);
+    fc_image_put_u32(header + FC_IMAGE_H_PERIODICAL_SIZE, FC_IMAGE_PERIODICAL_SIZE);
+    fc_image_put_u32(header + FC_IMAGE_H_OVERALL_COUNT, settings->regular_overall_count);
+    fc_image_put_u32(header + FC_IMAGE_H_ENABLED_COUNT, settings->regular_enabled_count);
+    fc_image_put_u32(header + FC_IMAGE_H_RESET_PAUSE, settings->reset_pause);
+    fc_image_put_u32(header + FC_IMAGE_H_DEEP_FILTER, settings->deep_filter);
+    fc_image_put_u32(header + FC_IMAGE_H_PERIODICAL_STATE, settings->periodical_state);
+    fc_image_put_u32(header + FC_IMAGE_H_REGULAR_OFFSET, (uint32_t)regular_offset);
+    fc_image_put_u32(header + FC_IMAGE_H_PERIODICAL_OFFSET, (uint32_t)periodical_offset);
+    fc_image_put_u32(header + FC_IMAGE_H_STRINGS_OFFSET, (uint32_t)strings_offset);
+    fc_image_put_u32(header + FC_IMAGE_H_STRINGS_SIZE, (uint32_t)strings_size);
+
+    // Образ пишется во временный файл и переименовывается только после успешной записи,
+    // чтобы при ошибке не оставлять усеченный образ
+    char temp_path[4096];
+
+    fc_temp_path(image_path, temp_path, sizeof(temp_path));
+
+    int image_fd = open(temp_path, O_CREAT | O_TRUNC | O_RDWR, S_IRWXU | S_IRWXG | S_IRWXO);
+
+    if (image_fd < 0)
+        return DEF_ERROR;
+
+    cfg_writer_t *writer = malloc(sizeof(cfg_writer_t));
+
+    if (writer == NULL)
+    {
+        close(image_fd);
+        unlink(temp_path);
+        return DEF_ERROR;
+    }
+
+    writer->fd = image_fd;
+    writer->error = 0;
+    writer->used = 0;
+    cfg_writer_put(writer, (const char *)header, sizeof(header));
+
+    // Записи ВК регулярного сообщения, комментарии идут в раздел строк подряд
+    uint32_t string_offset = 0;
+
+    for (i = 0; i < settings->regular_overall_count; i++)
+    {
+        const vc_regular_data_t *rd = &settings->vc_regular_array[i];
+        uint32_t comment_length = (uint32_t)strnlen(rd->comment, sizeof(rd->comment));
+        uint32_t values[] = {
+            string_offset, comment_length,
+            rd->dst_id, rd->src_id,
+            rd->input_port, rd->output_port,
+            rd->priority,
+            rd->input_asm_id, rd->output_asm_id,
+            rd->max_size,
+            rd->input_queue, rd->output_queue,
+            rd->timeout_AB
+        };
+        uint8_t *record = (uint8_t *)cfg_writer_reserve(writer, FC_IMAGE_REGULAR_SIZE);
+        size_t k = 0;
+
+        for (k = 0; k < sizeof(values) / sizeof(values[0]); k++)
+            fc_image_put_u32(record + k * 4, values[k]);
+
+        record[52] = (uint8_t)rd->type;
+        record[53] = rd->duplication;
+        record[54] = rd->channel_type;
+        record[55] = rd->enabled;
+        writer->used += FC_IMAGE_REGULAR_SIZE;
+        string_offset += comment_length + 1;
+    }
+
+    // Запись периодического сообщения (присутствует всегда, признак - periodical_state)
+    uint32_t periodical_values[] = {
+        string_offset, (uint32_t)strnlen(pd->comment, sizeof(pd->comment)),
+        pd->dst_id, pd->src_id,
+        pd->output_port,
+        pd->period,
+        pd->output_asm_id,
+        pd->max_size,
+        pd->priority
+    };
+    uint8_t *record = (uint8_t *)cfg_writer_reserve(writer, FC_IMAGE_PERIODICAL_SIZE);
+    size_t k = 0;
+
+    memset(record, 0, FC_IMAGE_PERIODICAL_SIZE);
+
+    for (k = 0; k < sizeof(periodical_values) / sizeof(periodical_values[0]); k++)
+        fc_image_put_u32(record + k * 4, periodical_values[k]);
+
+    record[36] = (uint8_t)pd->type;
+    record[37] = pd->duplication;
+    writer->used += FC_IMAGE_PERIODICAL_SIZE;
+
+    // Раздел строк
+    for (i = 0; i < settings->regular_overall_count; i++)
+    {
+        const char *comment = settings->vc_regular_array[i].comment;
+
+        cfg_writer_put(writer, comment, strnlen(comment, sizeof(settings->vc_regular_array[i].comment)) + 1);
+    }
+
+    cfg_writer_put(writer, pd->comment, strnlen(pd->comment, sizeof(pd->comment)) + 1);
+
+    int result = cfg_writer_flush(writer);
+
+    free(writer);
+
+    if (close(image_fd) != 0)
+        result = DEF_ERROR;
+
+    if (result != SUCCESS || rename(temp_path, image_path) != 0)
+    {
+        unlink(temp_path);
+        result = DEF_ERROR;
+    }
+
+    return result;
 }
 
 
 /*
- * Функция поиска объекта в JSON файле
+ * Функция открытия бинарного образа: файл отображается в память, проверяются заголовок
+ * и границы разделов. Записи затем читаются за O(1) без разбора
  *
  * Входные данные:
- *  cursor - указатель на позицию в массиве с данными JSON файла
- *  parent - родительский объект
+ *  image_path - путь к файлу образа
+ *  image      - образ (выходной параметр)
  *
  * Возвращаемое значение:
- *  положительное значение при наличии символа, иначе 0
+ *  SUCCESS или DEF_ERROR, если файл не прочитан или не является образом этой версии
  */
-static int json_parse_object (const char **cursor, json_value *parent)
+int fc_image_open (const char *image_path, fc_image_t *image)
 {
-    json_value result = { .type = TYPE_OBJECT };
-    vector_init(&result.value.object, sizeof(json_value));
+    memset(image, 0, sizeof(*image));
 
-    int success = 1;
+    if (json_input_open(image_path, &image->input) != SUCCESS)
+        return DEF_ERROR;
+
+    const uint8_t *data = (const uint8_t *)image->input.data;
+    uint64_t size = image->input.size;
 
-    while (success && !has_char(cursor, '}'))
+    if (size < FC_IMAGE_HEADER_SIZE || memcmp(data, FC_IMAGE_MAGIC, 8) != 0 ||
+        fc_image_get_u32(data + FC_IMAGE_H_VERSION) != FC_IMAGE_VERSION ||
+        fc_image_get_u32(data + FC_IMAGE_H_HEADER_SIZE) < FC_IMAGE_HEADER_SIZE)
     {
-        json_value key = { .type = TYPE_NULL };
-        json_value value = { .type = TYPE_NULL };
-        success = json_parse_value(cursor, &key);
-        success = (success && has_char(cursor, ':'));
-        success = (success && json_parse_value(cursor, &value));
+        json_input_close(&image->input);
+        return DEF_ERROR;
+    }
 
-        if (success)
+    image->data = data;
+    image->regular_count = fc_image_get_u32(data + FC_IMAGE_H_OVERALL_COUNT);
+    image->regular_size = fc_image_get_u32(data + FC_IMAGE_H_REGULAR_SIZE);
+    image->regular_offset = fc_image_get_u32(data + FC_IMAGE_H_REGULAR_OFFSET);
+    image->periodical_size = fc_image_get_u32(data + FC_IMAGE_H_PERIODICAL_SIZE);
+    image->periodical_offset = fc_image_get_u32(data + FC_IMAGE_H_PERIODICAL_OFFSET);
+    image->strings_offset = fc_image_get_u32(data + FC_IMAGE_H_STRINGS_OFFSET);
+    image->strings_size = fc_image_get_u32(data + FC_IMAGE_H_STRINGS_SIZE);
+
+    if (image->regular_size < FC_IMAGE_REGULAR_SIZE || image->periodical_size < FC_IMAGE_PERIODICAL_SIZE ||
+        (uint64_t)image->regular_offset + (uint64_t)image->regular_count * image->regular_size > size ||
+        (uint64_t)image->periodical_offset + image->periodical_size > size ||
+        (uint64_t)image->strings_offset + image->strings_size > size)
+    {
+        json_input_close(&image->input);
+        return DEF_ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/*
+ * Функция закрытия бинарного образа
+ *
+ * Входные данные:
+ *  image - образ
+ */
+void fc_image_close (fc_image_t *image)
+{
+    json_input_close(&image->input);
+    image->data = NULL;
+}
+
+
+/*
+ * Функция копирования комментария из раздела строк образа с проверкой границ
+ *
+ * Входные данные:
+ *  image   - образ
+ *  record  - запись (смещение и длина комментария - первые поля)
+ *  comment - буфер комментария
+ *  size    - размер буфера
+ *
+ * Возвращаемое значение:
+ *  1 - успешно, 0 - комментарий выходит за раздел строк или не помещается
+ */
+static int fc_image_comment (const fc_image_t *image, const uint8_t *record, char *comment, size_t size)
+{
+    uint32_t offset = fc_image_get_u32(record);
+    uint32_t length = fc_image_get_u32(record + 4);
+
+    if (length >= size || (uint64_t)offset + length >= image->strings_size)
+        return 0;
+
+    memset(comment, 0, size);
+    memcpy(comment, image->data + image->strings_offset + offset, length);
+
+    return 1;
+}
+
+
+/*
+ * Функция чтения записи ВК регулярного сообщения из образа по номеру
+ *
+ * Входные данные:
+ *  image - образ
+ *  index - номер записи
+ *  vc    - структура ВК (выходной параметр)
+ *
+ * Возвращаемое значение:
+ *  SUCCESS или DEF_ERROR при неверном номере или комментарии
+ */
+int fc_image_regular (const fc_image_t *image, uint32_t index, vc_regular_data_t *vc)
+{
+    if (index >= image->regular_count)
+        return DEF_ERROR;
+
+    const uint8_t *record = image->data + image->regular_offset + (size_t)index * image->regular_size;
+
+    memset(vc, 0, sizeof(*vc));
+
+    if (!fc_image_comment(image, record, vc->comment, sizeof(vc->comment)))
+        return DEF_ERROR;
+
+    vc->dst_id = fc_image_get_u32(record + 8);
+    vc->src_id = fc_image_get_u32(record + 12);
+    vc->input_port = fc_image_get_u32(record + 16);
+    vc->output_port = fc_image_get_u32(record + 20);
+    vc->priority = fc_image_get_u32(record + 24);
+    vc->input_asm_id = fc_image_get_u32(record + 28);
+    vc->output_asm_id = fc_image_get_u32(record + 32);
+    vc->max_size = fc_image_get_u32(record + 36);
+    vc->input_queue = fc_image_get_u32(record + 40);
+    vc->output_queue = fc_image_get_u32(record + 44);
+    vc->timeout_AB = fc_image_get_u32(record + 48);
+    vc->type = (char)record[52];
+    vc->duplication = record[53];
+    vc->channel_type = record[54];
+    vc->enabled = record[55];
+
+    return SUCCESS;
+}
+
+
+/*
+ * Функция чтения записи ВК периодического сообщения из образа
+ *
+ * Входные данные:
+ *  image - образ
+ *  vc    - структура ВК (выходной параметр)
+ *
+ * Возвращаемое значение:
+ *  SUCCESS или DEF_ERROR при неверном комментарии
+ */
+int fc_image_periodical (const fc_image_t *image, vc_periodical_data_t *vc)
+{
+    const uint8_t *record = image->data + image->periodical_offset;
+
+    memset(vc, 0, sizeof(*vc));
+
+    if (!fc_image_comment(image, record, vc->comment, sizeof(vc->comment)))
+        return DEF_ERROR;
+
+    vc->dst_id = fc_image_get_u32(record + 8);
+    vc->src_id = fc_image_get_u32(record + 12);
+    vc->output_port = fc_image_get_u32(record + 16);
+    vc->period = fc_image_get_u32(record + 20);
+    vc->output_asm_id = fc_image_get_u32(record + 24);
+    vc->max_size = fc_image_get_u32(record + 28);
+    vc->priority = fc_image_get_u32(record + 32);
+    vc->type = (char)record[36];
+    vc->duplication = record[37];
+
+    return SUCCESS;
+}
+
+
+/*
+ * Функция загрузки структуры настроек из бинарного образа
+ *
+ * Входные данные:
+ *  image_path - путь к файлу образа
+ *  settings   - структура настроек (выходной параметр, освобождается fc_settings_free)
+ *
+ * Возвращаемое значение:
+ *  SUCCESS, DEF_ERROR при неверном образе, -ENOMEM при ошибке выделения памяти
+ */
+int fc_settings_load_image (const char *image_path, fc_settings_t *settings)
+{
+    fc_image_t image;
+    int result = SUCCESS;
+    uint32_t i = 0;
+
+    memset(settings, 0, sizeof(*settings));
+
+    if (fc_image_open(image_path, &image) != SUCCESS)
+        return DEF_ERROR;
+
+    const uint8_t *header = image.data;
+
+    settings->reset_pause = fc_image_get_u32(header + FC_IMAGE_H_RESET_PAUSE);
+    settings->deep_filter = fc_image_get_u32(header + FC_IMAGE_H_DEEP_FILTER);
+    settings->regular_overall_count = image.regular_count;
+    settings->regular_enabled_count = fc_image_get_u32(header + FC_IMAGE_H_ENABLED_COUNT);
+    settings->periodical_state = (uint8_t)fc_image_get_u32(header + FC_IMAGE_H_PERIODICAL_STATE);
+
+    if (image.regular_count > 0)
+    {
+        settings->vc_regular_array = (vc_regular_data_t *)calloc(image.regular_count, sizeof(vc_regular_data_t));
+
+        if (settings->vc_regular_array == NULL)
+            result = -ENOMEM;
+    }
+
+    for (i = 0; result == SUCCESS && i < image.regular_count; i++)
+        result = fc_image_regular(&image, i, &settings->vc_regular_array[i]);
+
+    if (result == SUCCESS)
+        result = fc_image_periodical(&image, &settings->vc_periodical_array);
+
+    fc_image_close(&image);
+
+    if (result != SUCCESS)
+        fc_settings_free(settings);
+
+    return result;
+}
+
+
+/*
+ * Функция проверки образа: настройки, загруженные из образа, записываются в cfg
+ * во временный файл, который должен совпасть с cfg, полученным из JSON
+ *
+ * Входные данные:
+ *  image_path - путь к файлу образа
+ *  cfg_path   - путь к файлу cfg
+ *
+ * Возвращаемое значение:
+ *  SUCCESS или DEF_ERROR при расхождении либо ошибке чтения
+ */
+int fc_image_verify (const char *image_path, const char *cfg_path)
+{
+    fc_settings_t settings;
+    char temp_path[4096];
+    json_input expected;
+    json_input actual;
+    int result = DEF_ERROR;
+
+    if (fc_settings_load_image(image_path, &settings) != SUCCESS)
+        return DEF_ERROR;
+
+    fc_temp_path(cfg_path, temp_path, sizeof(temp_path));
+
+    if (fc_settings_write_cfg(&settings, temp_path) == SUCCESS && json_input_open(cfg_path, &expected) == SUCCESS)
+    {
+        if (json_input_open(temp_path, &actual) == SUCCESS)
+        {
+            if (actual.size == expected.size && memcmp(actual.data, expected.data, actual.size) == 0)
+                result = SUCCESS;
+
+            json_input_close(&actual);
+        }
+
+        json_input_close(&expected);
+    }
+
+    unlink(temp_path);
+    fc_settings_free(&settings);
+
+    return result;
+}
+#endif
+#endif
+
+
+#ifdef JSON_STATS
+/*
+ * Функция вывода статистики преобразования файла в JSON. Этапы, которые не выполнялись
+ * (попадание в кеш, разбор со стандартного ввода), не выводятся
+ *
+ * Входные данные:
+ *  file_path - путь к JSON-файлу
+ *  fd        - файловый дескриптор для вывода
+ */
+static void json_stats_report (const char *file_path, int fd)
+{
+    static const char *node_names[TYPE_INTEGER + 1] = { "null", "bool", "number", "object", "array", "string",
+                                                        "key", "integer" };
+    json_writer writer;
+    char line[256];
+    int i = 0;
+
+    json_writer_init(&writer, fd);
+
+    json_writer_put(&writer, "{\n\t\"file\": ", 11);
+    json_write_string(&writer, file_path, strlen(file_path));
+    json_writer_put(&writer, ",\n\t\"phases\": {", 14);
+
+    const char *separator = "";
+
+    for (i = 0; i < JSON_STATS_PHASES; i++)
+    {
+        const json_stats_phase_t *p = &json_stats.phases[i];
+
+        if (p->runs == 0)
+            continue;
+
+        int length = snprintf(line, sizeof(line),
+                              "%s\n\t\t\"%s\": {\"wall\": %.9f, \"cpu\": %.9f, \"bytes\": %llu, \"items\": %llu}",
+                              separator, json_stats_phase_names[i], p->wall, p->cpu,
+                              (unsigned long long)p->bytes, (unsigned long long)p->items);
+        json_writer_put(&writer, line, (size_t)length);
+        separator = ",";
+    }
+
+    json_writer_put(&writer, "\n\t},\n\t\"nodes\": {", 16);
+    separator = "";
+
+    for (i = 0; i <= TYPE_INTEGER; i++)
+    {
+        int length = snprintf(line, sizeof(line), "%s\"%s\": %llu", separator, node_names[i],
+                              (unsigned long long)json_stats.nodes[i]);
+        json_writer_put(&writer, line, (size_t)length);
+        separator = ", ";
+    }
+
+    int length = snprintf(line, sizeof(line),
+                          "},\n\t\"memory\": {\"allocations\": %llu, \"frees\": %llu, \"peak_bytes\": %llu}\n}\n",
+                          (unsigned long long)json_stats.allocations, (unsigned long long)json_stats.frees,
+                          (unsigned long long)json_stats.bytes_peak);
+    json_writer_put(&writer, line, (size_t)length);
+
+    json_writer_flush(&writer);
+    json_writer_free(&writer);
+}
+#endif
+
+
+int process_json_fcrt_settings_file (const char *file_path, const char *dest_path, const char *image_path, int threads, fc_cache_t *cache)
+{
+    int error_counter = 0;
+#ifdef ETHERNET_MODE
+    fc_settings_t ethernet_settings;
+    memset(&ethernet_settings, 0, sizeof(ethernet_settings));
+#else
+    fc_settings_t fcrt_settings;
+    memset(&fcrt_settings, 0, sizeof(fcrt_settings));
+#endif
+#ifdef ETHERNET_MODE
+    fc_settings_t *settings = &ethernet_settings;
+#else
+    fc_settings_t *settings = &fcrt_settings;
+#endif
+
+    json_input input;
+    int result_parse = SUCCESS;
+    char cache_path[4096];
+    int cached = 0;
+
+    if (strcmp(file_path, "-") == 0)
+    {
+        // Разбор по частям со стандартного ввода по мере поступления данных
+        result_parse = fc_settings_parse_fd(STDIN_FILENO, settings);
+    }
+    else if (json_input_open(file_path, &input) == SUCCESS)
+    {
+        // Ключ кеша вычисляется до разбора, который изменяет буфер. Образ строится
+        // из структуры настроек, поэтому при его записи кеш только пополняется
+        if (input.size > 0 && cache != NULL)
+        {
+            fc_cache_path(cache, input.data, input.size, cache_path, sizeof(cache_path));
+            cached = 1;
+
+            if (image_path == NULL && fc_cache_fetch(cache, cache_path, dest_path))
+            {
+                json_input_close(&input);
+                fc_cache_report(cache);
+                return SUCCESS;
+            }
+        }
+
+        if (input.size > 0 && (threads > 1 || JSON_STATS_ENABLED))
+        {
+            // Дерево строится целиком, записи REGULAR_CONFIG преобразуются параллельно. Для
+            // статистики (--stats) дерево строится и в одном потоке, чтобы этапы замерялись раздельно
+            result_parse = fc_settings_parse_tree(input.data, input.size, settings, threads);
+        }
+        else if (input.size > 0)
         {
-            vector_push_back(&result.value.object, &key);
-            vector_push_back(&result.value.object, &value);
+            // Потоковый разбор json-строки с заполнением структур без построения дерева
+            result_parse = fc_settings_parse(input.data, settings);
         }
         else
         {
-            json_free_value(&key);
-            break;
+            printf("empty file error\n");
+            error_counter++;
         }
 
-        skip_whitespace(cursor);
+        json_input_close(&input);
+    }
+    else
+    {
+        printf("read file error\n");
+        error_counter++;
+    }
 
-        if (has_char(cursor, '}'))
-            break;
-        else if (has_char(cursor, ','))
-            continue;
-        else
-            success = 0;
+    if (result_parse == -ENOMEM)
+    {
+        printf("malloc error\n");
+        error_counter++;
+    }
+    else if (result_parse != SUCCESS)
+    {
+        printf("parse error\n");
+        error_counter++;
     }
 
-    if (success)
+    if (error_counter > 0)
     {
-        *parent = result;
+        return DEF_ERROR;
     }
-    else
+
+    JSON_STATS_BEGIN(JSON_STATS_WRITE);
+    int written = fc_settings_write_cfg(settings, dest_path);
+    JSON_STATS_END(JSON_STATS_WRITE, json_stats_file_size(dest_path), settings->regular_overall_count);
+
+    if (written == SUCCESS && cached)
+        fc_cache_store(cache_path, dest_path);
+
+#ifndef ETHERNET_MODE
+#ifndef GREK_FCRT
+    // Бинарный образ проверяется обратным преобразованием в cfg
+    if (image_path != NULL &&
+        (fc_settings_write_image(settings, image_path) != SUCCESS || fc_image_verify(image_path, dest_path) != SUCCESS))
     {
-        json_free_value(&result);
+        printf("image error\n");
+        error_counter++;
     }
+#endif
+#endif
 
-    return success;
+    fc_settings_free(settings);
+
+    if (cache != NULL)
+        fc_cache_report(cache);
+
+    return (error_counter > 0) ? DEF_ERROR : SUCCESS;
 }
 
 
+// Результат преобразования одного файла в пакетном режиме
+#define FC_STATUS_OK            0
+#define FC_STATUS_READ          1
+#define FC_STATUS_EMPTY         2
+#define FC_STATUS_PARSE         3
+#define FC_STATUS_MEMORY        4
+#define FC_STATUS_WRITE         5
+
+static const char *fc_status_names[] = {
+    "ok", "read file error", "empty file error", "parse error", "malloc error", "write error"
+};
+
+// Буферы потока пакетной обработки, используемые для всех его файлов
+typedef struct
+{
+    json_input input;           // входные данные (читаются в кучу, а не отображаются в память)
+    json_scratch scratch;       // структурный индекс
+    cfg_writer_t writer;        // буфер записи cfg
+} fc_worker_t;
+
+// Пара файлов манифеста
+typedef struct
+{
+    const char *json_path;
+    const char *cfg_path;
+    int status;                 // FC_STATUS_*
+} fc_batch_entry_t;
+
+// Общее состояние пакетной обработки
+typedef struct
+{
+    fc_batch_entry_t *entries;
+    size_t count;
+    size_t next;                // следующая необработанная пара (атомарный счетчик)
+    fc_cache_t *cache;          // кеш результатов, NULL - без кеша
+} fc_batch_t;
+
+
 /*
- * Функция поиска массива в JSON файле
+ * Функция преобразования одного JSON-файла в файл cfg с буферами потока. Результат
+ * записывается во временный файл и переименовывается поверх cfg, поэтому читатель
+ * cfg видит либо прежнее, либо новое содержимое целиком. JSON-файл читается в буфер
+ * потока, а не отображается в память: наблюдаемый файл может быть перезаписан на месте
+ * во время преобразования
  *
  * Входные данные:
- *  cursor - указатель на позицию в массиве с данными JSON файла
- *  parent - родительский объект
+ *  json_path - путь к JSON-файлу
+ *  cfg_path  - путь к файлу cfg
+ *  worker    - буферы потока
+ *  cache     - кеш результатов (NULL - без кеша)
  *
  * Возвращаемое значение:
- *  положительное значение при наличии символа, иначе 0
+ *  FC_STATUS_*
  */
-static int json_parse_array (const char **cursor, json_value *parent)
+static int fc_convert_file (const char *json_path, const char *cfg_path, fc_worker_t *worker, fc_cache_t *cache)
 {
-    int success = 1;
-    if (**cursor == ']')
-    {
-        ++(*cursor);
-        return success;
-    }
+    json_input *input = &worker->input;
+    fc_settings_t settings;
+    char cache_path[4096];
+    char temp_path[4096];
 
-    while (success)
-    {
-        json_value new_value = { .type = TYPE_NULL };
-        success = json_parse_value(cursor, &new_value);
+    if (json_input_load(json_path, input) != SUCCESS)
+        return FC_STATUS_READ;
 
-        if (!success)
-            break;
+    if (input->size == 0)
+        return FC_STATUS_EMPTY;
 
-        skip_whitespace(cursor);
-        vector_push_back(&parent->value.array, &new_value);
-        skip_whitespace(cursor);
+    fc_temp_path(cfg_path, temp_path, sizeof(temp_path));
 
-        if (has_char(cursor, ']'))
-            break;
-        else if (has_char(cursor, ','))
-            continue;
-        else
-            success = 0;
+    if (cache != NULL)
+    {
+        fc_cache_path(cache, input->data, input->size, cache_path, sizeof(cache_path));
+
+        if (fc_cache_fetch(cache, cache_path, temp_path))
+        {
+            if (rename(temp_path, cfg_path) == 0)
+                return FC_STATUS_OK;
+
+            unlink(temp_path);
+            return FC_STATUS_WRITE;
+        }
     }
 
-    return success;
-}
+    int result = fc_settings_parse_scratch(input->data, &settings, &worker->scratch);
 
+    if (result != SUCCESS)
+        return (result == -ENOMEM) ? FC_STATUS_MEMORY : FC_STATUS_PARSE;
 
-/*
- * Функция освобождения объекта JSON-файла
- *
- * Входные данные:
- *  val - указатель объект
- */
-void json_free_value (json_value *val)
-{
-    if (!val)
-        return;
+    int cfg_fd = open(temp_path, O_CREAT | O_TRUNC | O_RDWR, S_IRWXU | S_IRWXG | S_IRWXO);
 
-    switch (val->type)
-    {
-    case TYPE_STRING:
+    if (cfg_fd < 0)
     {
-        free(val->value.string);
-        val->value.string = NULL;
-        break;
+        fc_settings_free(&settings);
+        return FC_STATUS_WRITE;
     }
-    case TYPE_ARRAY:
-    case TYPE_OBJECT:
+
+    worker->writer.fd = cfg_fd;
+    result = fc_settings_write_cfg_buffered(&settings, &worker->writer);
+    fc_settings_free(&settings);
+
+    if (close(cfg_fd) != 0)
+        result = DEF_ERROR;
+
+    if (result == SUCCESS && rename(temp_path, cfg_path) != 0)
+        result = DEF_ERROR;
+
+    if (result != SUCCESS)
     {
-        vector_foreach(&(val->value.array), (void (*)(void *)) json_free_value);
-        vector_free(&(val->value.array));
-        break;
-    }
+        unlink(temp_path);
+        return FC_STATUS_WRITE;
     }
 
-    val->type = TYPE_NULL;
+    if (cache != NULL)
+        fc_cache_store(cache_path, cfg_path);
+
+    return FC_STATUS_OK;
 }
 
 
 /*
- * Функция проверки наличия true, false, null в JSON-файле
+ * Функция потока пакетной обработки: пары берутся из общего счетчика до исчерпания
  *
  * Входные данные:
- *  cursor  - указатель на позицию в массиве с данными JSON файла
- *  literal - слово для поиска
+ *  arg - общее состояние (fc_batch_t)
  *
  * Возвращаемое значение:
- *  1 - при наличии символа, иначе 0
+ *  NULL
  */
-int json_is_literal (const char **cursor, const char *literal)
+static void *fc_batch_worker (void *arg)
 {
-    size_t cnt = strlen(literal);
+    fc_batch_t *batch = arg;
+    fc_worker_t *worker = calloc(1, sizeof(fc_worker_t));
+    size_t i = 0;
 
-    if (strncmp(*cursor, literal, cnt) == 0)
+    while ((i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) < batch->count)
     {
-        *cursor += cnt;
-        return 1;
+        fc_batch_entry_t *entry = &batch->entries[i];
+
+        entry->status = (worker != NULL) ? fc_convert_file(entry->json_path, entry->cfg_path, worker, batch->cache) : FC_STATUS_MEMORY;
     }
 
-    return 0;
+    if (worker != NULL)
+    {
+        json_input_close(&worker->input);
+        json_scratch_free(&worker->scratch);
+        free(worker);
+    }
+
+    return NULL;
 }
 
 
 /*
- * Функция парсинга JSON файла
+ * Функция пакетного преобразования пар файлов из манифеста в одном процессе. Каждая
+ * непустая строка манифеста, не начинающаяся с '#', содержит путь к JSON-файлу и путь
+ * к файлу cfg, разделенные пробелами или табуляцией. Результат по каждой паре выводится
+ * в порядке манифеста
  *
  * Входные данные:
- *  cursor - указатель на позицию в массиве с данными JSON файла
- *  parent - родительский объект
+ *  manifest_path - путь к манифесту
+ *  threads       - число потоков
+ *  cache         - кеш результатов (NULL - без кеша)
  *
  * Возвращаемое значение:
- *  положительное значение при наличии символа, иначе 0
+ *  SUCCESS, если преобразованы все пары, иначе DEF_ERROR
  */
-int json_parse_value (const char **cursor, json_value *parent)
+int process_json_fcrt_settings_batch (const char *manifest_path, int threads, fc_cache_t *cache)
 {
-    // Eat whitespace
-    int success = 0;
-    skip_whitespace(cursor);
+    json_input manifest;
+    fc_batch_t batch = { NULL, 0, 0, cache };
+    size_t capacity = 0;
+    size_t invalid = 0;
+    size_t converted = 0;
+    size_t i = 0;
 
-    switch (**cursor)
+    if (json_input_open(manifest_path, &manifest) != SUCCESS)
     {
-    case '\0':
-    {
-        // If parse_value is called with the cursor at the end of the string
-        // that's a failure
-        success = 0;
-
-        break;
+        printf("read file error\n");
+        return DEF_ERROR;
     }
 
-    case '"':
+    // Разбор манифеста на месте: пути завершаются нулем в буфере манифеста. Строка
+    // разбивается на поля только после проверки, чтобы в сообщение об ошибке попала целиком
+    char *line = manifest.data;
+    size_t line_number = 0;
+
+    while (*line != '\0')
     {
-        ++*cursor;
-        const char *start = *cursor;
-        char *end = strchr(*cursor, '"');
+        char *end = line + strcspn(line, "\n");
+        char *next = (*end != '\0') ? end + 1 : end;
+        char *fields[2] = { NULL, NULL };
+        char *ends[2] = { NULL, NULL };
+        int count = 0;
+        char *p = line;
 
-        if (end)
+        *end = '\0';
+        line_number++;
+
+        while (*p != '\0' && count < 3)
         {
-            size_t len = end - start;
-            char *new_string = malloc((len + 1) * sizeof(char));
+            p += strspn(p, " \t\r");
 
-            if (new_string == NULL)
-            {
-                success = 0;
-            }
-            else
+            if (*p == '\0' || (*p == '#' && count == 0))
+                break;
+
+            if (count < 2)
+                fields[count] = p;
+
+            p += strcspn(p, " \t\r");
+
+            if (count < 2)
+                ends[count] = p;
+
+            count++;
+        }
+
+        if (count == 2)
+        {
+            *ends[0] = '\0';
+            *ends[1] = '\0';
+
+            if (batch.count == capacity)
             {
-                memcpy(new_string, start, len);
-                new_string[len] = '\0';
+                capacity = capacity ? capacity * 2 : 64;
+                fc_batch_entry_t *entries = realloc(batch.entries, capacity * sizeof(fc_batch_entry_t));
 
-                if (len != strlen(new_string))
+                if (entries == NULL)
                 {
-                    free(new_string);
-                    success = 0;
+                    printf("malloc error\n");
+                    free(batch.entries);
+                    json_input_close(&manifest);
+                    return DEF_ERROR;
                 }
-                else
-                {
-                    parent->type = TYPE_STRING;
-                    parent->value.string = new_string;
 
-                    *cursor = end + 1;
-                    success = 1;
-                }
+                batch.entries = entries;
             }
+
+            batch.entries[batch.count].json_path = fields[0];
+            batch.entries[batch.count].cfg_path = fields[1];
+            batch.entries[batch.count].status = FC_STATUS_READ;
+            batch.count++;
+        }
+        else if (count != 0)
+        {
+            printf("manifest error: line %zu: %s\n", line_number, line);
+            invalid++;
         }
 
-        break;
+        line = next;
     }
 
-    case '{':
-    {
-        ++(*cursor);
-        skip_whitespace(cursor);
-        success = json_parse_object(cursor, parent);
+    pthread_t workers[FC_PARALLEL_MAX_THREADS];
+    int started[FC_PARALLEL_MAX_THREADS] = { 0 };
+    size_t workers_count = (threads > 1) ? (size_t)threads : 1;
 
-        break;
-    }
+    // Таблицы описаний и выбор классификатора кешируются в статических переменных,
+    // поэтому заполняются до запуска потоков
+    vc_schema_init(&vc_regular_schema);
+    vc_schema_init(&vc_periodical_schema);
+    json_select_classifier();
 
-    case '[':
-    {
-        parent->type = TYPE_ARRAY;
-        vector_init(&parent->value.array, sizeof(json_value));
-        ++(*cursor);
-        skip_whitespace(cursor);
-        success = json_parse_array(cursor, parent);
+    if (workers_count > batch.count)
+        workers_count = batch.count;
 
-        if (!success)
-        {
-            vector_free(&parent->value.array);
-        }
+    for (i = 1; i < workers_count; i++)
+        started[i] = (pthread_create(&workers[i], NULL, fc_batch_worker, &batch) == 0);
 
-        break;
+    fc_batch_worker(&batch);
+
+    for (i = 1; i < workers_count; i++)
+    {
+        if (started[i])
+            pthread_join(workers[i], NULL);
     }
 
-    case 't':
+    for (i = 0; i < batch.count; i++)
     {
-        success = json_is_literal(cursor, "true");
+        fc_batch_entry_t *entry = &batch.entries[i];
 
-        if (success)
-        {
-            parent->type = TYPE_BOOL;
-            parent->value.boolean = 1;
-        }
+        printf("%s\t%s\t%s\n", fc_status_names[entry->status], entry->json_path, entry->cfg_path);
 
-        break;
+        if (entry->status == FC_STATUS_OK)
+            converted++;
     }
 
-    case 'f':
-    {
-        success = json_is_literal(cursor, "false");
+    printf("converted %zu of %zu\n", converted, batch.count);
 
-        if (success)
-        {
-            parent->type = TYPE_BOOL;
-            parent->value.boolean = 0;
-        }
+    if (cache != NULL)
+        fc_cache_report(cache);
 
-        break;
+    free(batch.entries);
+    json_input_close(&manifest);
+
+    return (converted == batch.count && invalid == 0) ? SUCCESS : DEF_ERROR;
+}
+
+
+/*
+ * Функция резидентного режима: JSON-файл преобразуется при запуске и затем при каждом
+ * его изменении, буферы чтения, разбора и записи сохраняются между преобразованиями.
+ * Наблюдается каталог файла, поэтому замена файла через переименование тоже замечается
+ *
+ * Входные данные:
+ *  file_path - путь к JSON-файлу
+ *  dest_path - путь к файлу cfg
+ *  cache     - кеш результатов (NULL - без кеша)
+ *
+ * Возвращаемое значение:
+ *  DEF_ERROR при ошибке наблюдения (при нормальной работе функция не возвращается)
+ */
+int process_json_fcrt_settings_watch (const char *file_path, const char *dest_path, fc_cache_t *cache)
+{
+    char directory[4096];
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const char *name = strrchr(file_path, '/');
+
+    if (name == NULL)
+    {
+        snprintf(directory, sizeof(directory), ".");
+        name = file_path;
     }
+    else
+    {
+        int length = (name == file_path) ? 1 : (int)(name - file_path);
 
-    case 'n':
+        snprintf(directory, sizeof(directory), "%.*s", length, file_path);
+        name++;
+    }
+
+    vc_schema_init(&vc_regular_schema);
+    vc_schema_init(&vc_periodical_schema);
+
+    fc_worker_t *worker = calloc(1, sizeof(fc_worker_t));
+    int notify_fd = inotify_init1(IN_CLOEXEC);
+
+    if (worker == NULL || notify_fd < 0 ||
+        inotify_add_watch(notify_fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF) < 0)
     {
-        success = json_is_literal(cursor, "null");
-        break;
+        printf("could not watch %s\n", directory);
+
+        if (notify_fd >= 0)
+            close(notify_fd);
+
+        free(worker);
+        return DEF_ERROR;
     }
 
-    default:
+    int changed = 1;
+    int watching = 1;
+    char *p = NULL;
+
+    while (watching)
     {
-        char* end;
-        double number = strtod(*cursor, &end);
+        if (changed)
+        {
+            int status = fc_convert_file(file_path, dest_path, worker, cache);
+
+            printf("%s\t%s\t%s\n", fc_status_names[status], file_path, dest_path);
+            fflush(stdout);
+            changed = 0;
+        }
+
+        ssize_t got = read(notify_fd, events, sizeof(events));
+
+        if (got < 0 && errno == EINTR)
+            continue;
 
-        if (*cursor != end)
+        if (got <= 0)
+            break;
+
+        // все события одного чтения сводятся к одному преобразованию
+        for (p = events; p < events + got; )
         {
-            parent->type = TYPE_NUMBER;
-            parent->value.number = number;
-            *cursor = end;
-            success = 1;
+            const struct inotify_event *event = (const struct inotify_event *)p;
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+                watching = 0;
+            else if (event->len > 0 && strcmp(event->name, name) == 0)
+                changed = 1;
+
+            p += sizeof(struct inotify_event) + event->len;
         }
     }
-    }
 
-    return success;
+    printf("stopped watching %s\n", directory);
+
+    close(notify_fd);
+    json_input_close(&worker->input);
+    json_scratch_free(&worker->scratch);
+    free(worker);
+
+    return DEF_ERROR;
 }
 
 
 /*
- * Функция конвертации объекта в строку
+ * Функция вывода значения JSON-файла по указателю JSON. Разбирается только найденное
+ * значение, остальной документ пропускается по структурному индексу
  *
  * Входные данные:
- *  value - объект
+ *  file_path - путь к JSON-файлу
+ *  pointer   - указатель JSON (RFC 6901)
  *
  * Возвращаемое значение:
- *  конвертированная строка
+ *  SUCCESS или DEF_ERROR, если файл не прочитан, указатель неверен или значение не найдено
  */
-char *json_value_to_string (json_value *value)
+int process_json_query (const char *file_path, const char *pointer)
 {
-    if (value->type != TYPE_STRING)
-        return NULL;
+    json_input input;
+    json_pointer path;
+    json_lazy_doc doc;
+    json_lazy found;
+    json_value value;
+    json_arena arena;
+    int result = DEF_ERROR;
+
+    if (json_pointer_compile(pointer, &path) != SUCCESS)
+    {
+        printf("pointer error: %s\n", pointer);
+        return DEF_ERROR;
+    }
+
+    if (json_input_open(file_path, &input) != SUCCESS)
+    {
+        printf("read file error\n");
+        json_pointer_free(&path);
+        return DEF_ERROR;
+    }
+
+    if (json_lazy_open(&doc, input.data, NULL) == SUCCESS)
+    {
+        json_lazy root = json_lazy_root(&doc);
+
+        json_arena_init(&arena, 0);
+
+        if (json_lazy_pointer(&root, &path, &found) && json_lazy_value(&found, &value, &arena))
+        {
+            result = json_write_fd(&value, STDOUT_FILENO, JSON_WRITE_PRETTY);
+        }
+        else
+        {
+            printf("not found: %s\n", pointer);
+        }
+
+        json_arena_release(&arena);
+        json_lazy_close(&doc);
+    }
 
-    return (char *)value->value.string;
+    json_input_close(&input);
+    json_pointer_free(&path);
+
+    return result;
 }
 
 
+#ifdef JSON_BENCH
+// Число повторов каждого замера по умолчанию (учитывается лучшее время)
+#define BENCH_REPEATS           5
+// Максимальное число записей REGULAR_CONFIG в синтетическом файле
+#define BENCH_MAX_ENTRIES       1000000
+
+// Этапы обработки файла
+enum bench_phase {
+    BENCH_LOAD,         // json_input_open
+    BENCH_PARSE,        // json_parse_arena (дерево в арене, разбор на месте)
+    BENCH_CONVERT,      // fc_settings_from_json
+    BENCH_EMIT,         // fc_settings_write_cfg
+    BENCH_FREE,         // json_arena_release, fc_settings_free, json_input_close
+    BENCH_SAX,          // fc_settings_parse (разбор и заполнение без дерева)
+    BENCH_TAPE_PARSE,   // json_tape_parse
+    BENCH_TAPE_CONVERT, // fc_settings_from_tape
+    BENCH_SERIALIZE,    // json_serialize (дерево в компактный JSON)
+    BENCH_PHASES
+};
+
+static const char *bench_phase_names[BENCH_PHASES] = { "load", "parse", "convert", "emit", "free", "sax_convert",
+                                                         "tape_parse", "tape_convert", "serialize" };
+
+// Аппаратные счетчики этапов (perf_event_open, только пользовательский режим)
+enum bench_counter {
+    BENCH_CYCLES,
+    BENCH_INSTRUCTIONS,
+    BENCH_BRANCH_MISSES,
+    BENCH_L1D_MISSES,   // промахи чтения L1 данных
+    BENCH_LLC_MISSES,   // промахи чтения кеша последнего уровня
+    BENCH_COUNTERS
+};
+
+static const char *bench_counter_names[BENCH_COUNTERS] = { "cycles", "instructions", "branch_misses", "l1d_misses",
+                                                             "llc_misses" };
+
+// Группа счетчиков, читаемая одним вызовом read. Ведущий - циклы; без него счетчики не используются,
+// остальные подключаются, если процессор (или гипервизор) их поддерживает
+typedef struct {
+    int leader;                     // дескриптор ведущего счетчика, -1 - счетчики недоступны
+    int fds[BENCH_COUNTERS];        // -1 - счетчик не открыт
+    int order[BENCH_COUNTERS];      // счетчики в порядке значений при чтении группы
+    int count;                      // число открытых счетчиков
+} bench_counters_t;
+
+// Показание времени и счетчиков на границе этапов
+typedef struct {
+    double time;
+    uint64_t values[BENCH_COUNTERS];
+    uint64_t enabled;               // время, когда группа была включена, нс
+    uint64_t running;               // время, когда группа считала (меньше enabled при мультиплексировании)
+} bench_sample_t;
+
+// Итог этапа: лучшее время и значения счетчиков того же повтора
+typedef struct {
+    double seconds;                 // -1 - этап еще не замерялся
+    double values[BENCH_COUNTERS];  // -1 - счетчик недоступен
+} bench_result_t;
+
+
 /*
- * Функция конвертации объекта в числовое значение
- *
- * Входные данные:
- *  value - объект
+ * Функция получения монотонного времени
  *
  * Возвращаемое значение:
- *  числовое значение
+ *  время в секундах
  */
-double json_value_to_double (json_value *value)
+static double bench_now (void)
 {
-    if (value->type != TYPE_NUMBER)
-        return 0;
+    struct timespec ts;
 
-    return value->value.number;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
 }
 
 
 /*
- * Функция конвертации объекта в булевое значение
+ * Функция открытия группы аппаратных счетчиков текущего потока. Группа включается сразу
+ * и считает непрерывно, этапы выделяются разностью показаний
  *
  * Входные данные:
- *  value - объект
+ *  counters - группа счетчиков (выходной параметр)
  *
  * Возвращаемое значение:
- *  булевое значение
+ *  SUCCESS или DEF_ERROR (с кодом в errno), если недоступен счетчик циклов
  */
-int json_value_to_bool (json_value *value)
+static int bench_counters_open (bench_counters_t *counters)
 {
-    if (value->type != TYPE_BOOL)
-        return 0;
+    static const struct { uint32_t type; uint64_t config; } events[BENCH_COUNTERS] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    };
+    int i = 0;
+
+    counters->leader = -1;
+    counters->count = 0;
+
+    for (i = 0; i < BENCH_COUNTERS; i++)
+    {
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.disabled = (i == 0);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        counters->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, counters->leader, 0);
+
+        if (counters->fds[i] < 0)
+        {
+            if (i == 0)
+                return DEF_ERROR;
+
+            continue;
+        }
 
-    return value->value.boolean;
+        if (i == 0)
+            counters->leader = counters->fds[i];
+
+        counters->order[counters->count++] = i;
+    }
+
+    ioctl(counters->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(counters->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    return SUCCESS;
 }
 
 
 /*
- * Функция конвертации объекта в вектор
+ * Функция закрытия группы аппаратных счетчиков
  *
  * Входные данные:
- *  value - объект
- *
- * Возвращаемое значение:
- *  указатель на вектор
+ *  counters - группа счетчиков
  */
-vector *json_value_to_array (json_value *value)
+static void bench_counters_close (bench_counters_t *counters)
 {
-    if (value->type != TYPE_ARRAY)
-        return NULL;
+    int i = 0;
 
-    return &value->value.array;
+    for (i = 0; i < BENCH_COUNTERS && counters->leader >= 0; i++)
+    {
+        if (counters->fds[i] >= 0)
+            close(counters->fds[i]);
+    }
+
+    counters->leader = -1;
+    counters->count = 0;
 }
 
 
 /*
- * Функция конвертации объекта в объектный тип
+ * Функция снятия показаний счетчиков и времени. Чтение группы - один системный вызов
  *
  * Входные данные:
- *  value - объект
- *
- * Возвращаемое значение:
- *  указатель на вектор объектного типа
+ *  counters - группа счетчиков
+ *  sample   - показание (выходной параметр)
  */
-vector *json_value_to_object (json_value *value)
+static void bench_sample (const bench_counters_t *counters, bench_sample_t *sample)
 {
-    if (value->type != TYPE_OBJECT)
-        return NULL;
+    uint64_t data[3 + BENCH_COUNTERS];
+    int i = 0;
 
-    return &value->value.object;
+    memset(sample, 0, sizeof(*sample));
+
+    // Формат группы: число счетчиков, время включения, время счета, значения
+    if (counters->leader >= 0 && read(counters->leader, data, sizeof(data)) >= (ssize_t)(3 * sizeof(uint64_t)))
+    {
+        sample->enabled = data[1];
+        sample->running = data[2];
+
+        for (i = 0; i < counters->count && (uint64_t)i < data[0]; i++)
+            sample->values[counters->order[i]] = data[3 + i];
+    }
+
+    sample->time = bench_now();
 }
 
 
 /*
- * Функция получения узла по индексу
+ * Функция учета замера этапа: если время лучше сохраненного, сохраняются время и счетчики.
+ * При мультиплексировании счетчиков значения масштабируются на долю времени счета, если
+ * группа не считала ни разу, счетчики помечаются как отсутствующие
  *
  * Входные данные:
- *  root  - объект
- *  index - индекс в массиве
- *
- * Возвращаемое значение:
- *  указатель на узел
+ *  counters - группа счетчиков
+ *  result   - итог этапа
+ *  begin    - показание в начале этапа
+ *  end      - показание в конце этапа
  */
-json_value *json_value_at (const json_value *root, size_t index)
+static void bench_record (const bench_counters_t *counters, bench_result_t *result, const bench_sample_t *begin,
+                          const bench_sample_t *end)
 {
-    if (root->type != TYPE_ARRAY)
-        return NULL;
+    double seconds = end->time - begin->time;
+    uint64_t enabled = end->enabled - begin->enabled;
+    uint64_t running = end->running - begin->running;
+    double scale = (running > 0 && running < enabled) ? (double)enabled / (double)running : 1.0;
+    int i = 0;
 
-    if (root->value.array.size >= index)
-    {
-        return vector_get_checked(&root->value.array,index);
-    }
-    else
+    if (result->seconds >= 0 && seconds >= result->seconds)
+        return;
+
+    result->seconds = seconds;
+
+    for (i = 0; i < BENCH_COUNTERS; i++)
+        result->values[i] = -1;
+
+    // Группа не была запланирована на время этапа: значений нет, поля остаются пустыми
+    if (running == 0)
+        return;
+
+    for (i = 0; i < counters->count; i++)
     {
-        return NULL;
+        int counter = counters->order[i];
+
+        result->values[counter] = (double)(end->values[counter] - begin->values[counter]) * scale;
     }
 }
 
 
 /*
- * Функция получения узла по ключу
+ * Функция генерации синтетического файла настроек в формате server_settings.json
+ *
  * Входные данные:
- *  root - объект
- *  key  - ключ
+ *  path    - путь к создаваемому файлу
+ *  entries - число записей REGULAR_CONFIG
  *
  * Возвращаемое значение:
- *  указатель на узел
+ *  размер файла в байтах либо 0 при ошибке
  */
-json_value *json_value_with_key (const json_value *root, const char *key)
+static size_t bench_generate (const char *path, size_t entries)
 {
-    if (root->type != TYPE_OBJECT)
-        return NULL;
-
-    json_value* data = (json_value*)root->value.object.data;
-    size_t size = root->value.object.size;
+    static const char *duplication[] = { "A", "B", "AB" };
+    FILE *file = fopen(path, "w");
     size_t i = 0;
 
-    for (i = 0; i < size; i += 2)
+    if (file == NULL)
+        return 0;
+
+    fprintf(file, "{\n\t\"COMMON_CONFIG\" :\n\t[\n"
+                  "\t\t{\n\t\t\t\"comment\" : \t\"Пауза между первым LINK UP и сбросом\",\n"
+                  "\t\t\t\"name\" :\t\"pause\",\n\t\t\t\"value\" :\t5\n\t\t},\n"
+                  "\t\t{\n\t\t\t\"comment\" : \t\"Глубина фильтра ошибок линка\",\n"
+                  "\t\t\t\"name\" :\t\"fc_rx_err_delay\",\n\t\t\t\"value\" :\t123\n\t\t}\n"
+                  "\t],\n\t\"REGULAR_CONFIG\" :\n\t[\n");
+
+    for (i = 0; i < entries; i++)
     {
-        if (strcmp(data[i].value.string, key) == 0)
-        {
-            return &data[i + 1];
-        }
+        fprintf(file, "\t\t{\n"
+                      "\t\t\t\"comment\" :\t\"Сообщение БЦВМ%zu на модуль %zu\",\n"
+                      "\t\t\t\"type\" : \t\"%s\",\n"
+                      "\t\t\t\"dst_id\" : \t%zu,\n"
+                      "\t\t\t\"src_id\" : \t15,\n"
+                      "\t\t\t\"input_port\" : \t%zu,\n"
+                      "\t\t\t\"output_port\" : %zu,\n"
+                      "\t\t\t\"priority\" : \t%zu,\n"
+                      "\t\t\t\"input_asm_id\" : %zu,\n"
+                      "\t\t\t\"output_asm_id\" : %zu,\n"
+                      "\t\t\t\"max_size\" : \t33024,\n"
+                      "\t\t\t\"input_queue\" : 64,\n"
+                      "\t\t\t\"output_queue\" : 64,\n"
+                      "\t\t\t\"duplication\" : \"%s\",\n"
+                      "\t\t\t\"channel_type\" : \"%s\",\n"
+                      "\t\t\t\"timeout_AB\" : 100,\n"
+                      "\t\t\t\"active\" :\t\"%s\"\n"
+                      "\t\t}%s\n",
+                i % 4 + 1, i, (i % 3) ? "LOW" : "HIGH", i % 7, i % 65536, (i + 1) % 65536, i % 64,
+                101000 + i, 400000 + i, duplication[i % 3], (i % 5 == 0) ? "ASM" : "FCRT",
+                (i % 11 == 0) ? "OFF" : "ON", (i + 1 < entries) ? "," : "");
     }
 
-    return NULL;
+    fprintf(file, "\t],\n\t\"PERIODICAL_CONFIG\" :\n\t[\n"
+                  "\t\t{\n\t\t\t\"comment\" :\t\"Статусное сообщение от СД на БЦВМ1\",\n"
+                  "\t\t\t\"dst_id\" : 5,\n\t\t\t\"src_id\" : 15,\n\t\t\t\"output_port\" : 60,\n"
+                  "\t\t\t\"period\" : \t100,\n\t\t\t\"output_asm_id\" : 400000,\n\t\t\t\"max_size\" : \t24,\n"
+                  "\t\t\t\"duplication\" : \"AB\",\n\t\t\t\"priority\" : 63,\n\t\t\t\"active\" :\t\"ON\"\n"
+                  "\t\t}\n\t]\n}\n");
+
+    long size = ftell(file);
+
+    if (fclose(file) != 0 || size <= 0)
+        return 0;
+
+    return (size_t)size;
 }
 
 
 /*
- * Функция парсинга JSON-файла (первый этап)
+ * Функция замера этапов обработки одного файла. Для каждого этапа сохраняются лучшее время
+ * и показания счетчиков того же повтора
+ *
  * Входные данные:
- *  input  - указатель на массив с данными JSON файла
- *  result - объект распарсенного JSON-файла
+ *  json_path - путь к файлу JSON
+ *  cfg_path  - путь к файлу cfg
+ *  repeats   - число повторов
+ *  counters  - группа аппаратных счетчиков (может быть не открыта)
+ *  best      - итоги этапов (выходной параметр)
  *
  * Возвращаемое значение:
- *  положительное значение при наличии символа, иначе 0
+ *  SUCCESS или DEF_ERROR
  */
-int json_parse (const char *input, json_value *result)
+static int bench_run (const char *json_path, const char *cfg_path, int repeats, const bench_counters_t *counters,
+                      bench_result_t *best)
 {
-    return json_parse_value(&input, result);
-}
+    int r = 0;
+    int i = 0;
 
+    for (i = 0; i < BENCH_PHASES; i++)
+        best[i].seconds = -1;
 
+    for (r = 0; r < repeats; r++)
+    {
+        bench_sample_t t[BENCH_SAX + 1];
+        bench_sample_t begin;
+        bench_sample_t end;
+        json_input input;
+        json_arena arena;
+        json_value root;
+        fc_settings_t settings;
 
-int process_json_fcrt_settings_file (const char *file_path, const char *dest_path)
-{
-    int error_counter = 0;
-#ifdef ETHERNET_MODE
-    fc_settings_t ethernet_settings;
-    ethernet_settings.regular_enabled_count = 0;
-    ethernet_settings.regular_overall_count = 0;
-    ethernet_settings.periodical_state = VC_OFF;
-#else
-    fc_settings_t fcrt_settings;
-    fcrt_settings.regular_enabled_count = 0;
-    fcrt_settings.regular_overall_count = 0;
-    fcrt_settings.periodical_state = VC_OFF;
-#endif
+        bench_sample(counters, &t[0]);
 
-    int json_fd = open(file_path, O_RDONLY);
+        if (json_input_open(json_path, &input) != SUCCESS)
+            return DEF_ERROR;
 
-    if (json_fd >= 0)
-    {
-        uint32_t size = (uint32_t)get_file_size(file_path);
+        bench_sample(counters, &t[1]);
+        json_arena_init(&arena, input.size);
 
-        if (size > 0)
+        if (json_parse_arena(input.data, &root, &arena, JSON_PARSE_IN_SITU) != 1)
+        {
+            json_arena_release(&arena);
+            json_input_close(&input);
+            return DEF_ERROR;
+        }
+
+        bench_sample(counters, &t[2]);
+
+        if (fc_settings_from_json(&root, &settings, 1) != SUCCESS)
         {
-            // Выделение буфера под данные json-файла
-            char *file_buffer = malloc(size);
+            json_arena_release(&arena);
+            json_input_close(&input);
+            return DEF_ERROR;
+        }
 
-            if (file_buffer)
-            {
-                // Чтение файла
-                ssize_t read_bytes = read(json_fd, file_buffer, size);
+        bench_sample(counters, &t[3]);
+        fc_settings_write_cfg(&settings, cfg_path);
+        bench_sample(counters, &t[4]);
+        json_arena_release(&arena);
+        fc_settings_free(&settings);
+        json_input_close(&input);
+        bench_sample(counters, &t[5]);
 
-                if (read_bytes == size)
-                {
-                    // Инициализация структуры и парсинг json-строки
-                    json_value result = {.type = TYPE_NULL};
-                    json_value root;
+        for (i = 0; i < BENCH_SAX; i++)
+            bench_record(counters, &best[i], &t[i], &t[i + 1]);
 
-                    int result_parse = json_parse(file_buffer, &root);
+        // Разбор на месте изменяет буфер, поэтому файл загружается заново
+        if (json_input_open(json_path, &input) != SUCCESS)
+            return DEF_ERROR;
 
-                    if (result_parse == 1)
-                    {
-                        // Поиск узла REGULAR_CONFIG
-                        json_value *regular_root = json_value_with_key(&root, "REGULAR_CONFIG");
+        bench_sample(counters, &begin);
+        int result = fc_settings_parse(input.data, &settings);
+        bench_sample(counters, &end);
 
-                        if (regular_root != NULL)
-                        {
-                            if (regular_root->value.array.size > 0)
-                            {
-#ifdef ETHERNET_MODE
-                                // Заполнение общего числа строк
-                                ethernet_settings.regular_overall_count = regular_root->value.array.size;
+        fc_settings_free(&settings);
+        json_input_close(&input);
 
-                                // Выделение памяти под массив структур ВК регулярного сообщения
-                                ethernet_settings.vc_regular_array = (vc_regular_data_t *)malloc(sizeof(vc_regular_data_t) * regular_root->value.array.size);
+        if (result != SUCCESS)
+            return DEF_ERROR;
 
-                                if (ethernet_settings.vc_regular_array)
-#else
-                                // Заполнение общего числа строк
-                                fcrt_settings.regular_overall_count = regular_root->value.array.size;
+        bench_record(counters, &best[BENCH_SAX], &begin, &end);
 
-                                // Выделение памяти под массив структур ВК регулярного сообщения
-                                fcrt_settings.vc_regular_array = (vc_regular_data_t *)malloc(sizeof(vc_regular_data_t) * regular_root->value.array.size);
+        // Лента: разбор и заполнение настроек по ней
+        json_tape tape;
+        bench_sample_t converted;
 
-                                if (fcrt_settings.vc_regular_array)
-#endif
-                                {
-                                    // Парсинг файла конфигурации и заполнение структур
-                                    size_t i = 0;
+        if (json_input_open(json_path, &input) != SUCCESS)
+            return DEF_ERROR;
 
-                                    for (i = 0; i < regular_root->value.array.size; i++)
-                                    {
-                                        json_value *regular_vc = json_value_at(regular_root, i);
+        json_tape_init(&tape);
 
-                                        if (regular_vc != NULL)
-                                        {
-#ifdef ETHERNET_MODE
-                                            // Проверка включения ВК
-                                            json_value *value = json_value_with_key(regular_vc, "active");
-
-                                            if (value != NULL)
-                                            {
-                                                char *active = json_value_to_string(value);
-
-                                                if (!strcmp(active, "ON"))
-                                                {
-                                                    ethernet_settings.vc_regular_array[i].enabled = VC_ON;
-                                                }
-                                                else
-                                                {
-                                                    ethernet_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                    continue;
-                                                }
-                                            }
-                                            else
-                                            {
-                                                ethernet_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Проверка типа ВК
-                                            value = json_value_with_key(regular_vc, "type");
-
-                                            if (value != NULL)
-                                            {
-                                                char *type = json_value_to_string(value);
-
-                                                if (!strcmp(type, "LOW"))
-                                                {
-                                                    ethernet_settings.vc_regular_array[i].type = VC_TYPE_LOW;
-                                                }
-                                                else if (!strcmp(type, "HIGH"))
-                                                {
-                                                    ethernet_settings.vc_regular_array[i].type = VC_TYPE_HIGH;
-                                                }
-                                                else
-                                                {
-                                                    ethernet_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                    continue;
-                                                }
-                                            }
-                                            else
-                                            {
-                                                ethernet_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Проверка включения ВК
-                                            value = json_value_with_key(regular_vc, "client_ip");
-
-                                            if (value != NULL)
-                                            {
-                                                char *client_ip = json_value_to_string(value);
-
-                                                memset(ethernet_settings.vc_regular_array[i].client_ip, 0, 16);
-                                                strcpy(ethernet_settings.vc_regular_array[i].client_ip, client_ip);
-                                            }
-                                            else
-                                            {
-                                                ethernet_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Проверка DST_ID
-                                            value = json_value_with_key(regular_vc, "client_rcv_port");
-
-                                            if (value != NULL)
-                                            {
-                                                ethernet_settings.vc_regular_array[i].client_rcv_port = (uint32_t)json_value_to_double(value);
-                                            }
-                                            else
-                                            {
-                                                ethernet_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Проверка DST_ID
-                                            value = json_value_with_key(regular_vc, "server_rcv_port");
-
-                                            if (value != NULL)
-                                            {
-                                                ethernet_settings.vc_regular_array[i].server_rcv_port = (uint32_t)json_value_to_double(value);
-                                            }
-                                            else
-                                            {
-                                                ethernet_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Проверка DST_ID
-                                            value = json_value_with_key(regular_vc, "server_snd_port");
-
-                                            if (value != NULL)
-                                            {
-                                                ethernet_settings.vc_regular_array[i].server_snd_port = (uint32_t)json_value_to_double(value);
-                                            }
-                                            else
-                                            {
-                                                ethernet_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Проверка выходного порта
-                                            value = json_value_with_key(regular_vc, "priority");
-
-                                            if (value != NULL)
-                                            {
-                                                ethernet_settings.vc_regular_array[i].priority = (uint32_t)json_value_to_double(value);
-                                            }
-                                            else
-                                            {
-                                                ethernet_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Увеличение счетчика корректных ВК регклярного сообщения
-                                            ethernet_settings.regular_enabled_count++;
+        bench_sample(counters, &begin);
+        result = json_tape_parse(input.data, &tape, NULL) ? SUCCESS : DEF_ERROR;
+        bench_sample(counters, &end);
 
-#else
-                                            // Проверка включения ВК
-                                            json_value *value = json_value_with_key(regular_vc, "active");
-
-                                            if (value != NULL)
-                                            {
-                                                char *active = json_value_to_string(value);
-
-                                                if (!strcmp(active, "ON"))
-                                                {
-                                                    fcrt_settings.vc_regular_array[i].enabled = VC_ON;
-                                                }
-                                                else
-                                                {
-                                                    fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                    // continue;
-                                                }
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-                                            //копируем комментарий
-                                            value = json_value_with_key(regular_vc, "comment");
-                                            if (value != NULL)
-                                            {
-                                                char *comment = json_value_to_string(value);
-                                                snprintf(fcrt_settings.vc_regular_array[i].comment, sizeof(fcrt_settings.vc_regular_array[i].comment), "\n# %s\n", comment);
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-
-                                            // Проверка типа ВК
-                                            value = json_value_with_key(regular_vc, "type");
-
-                                            if (value != NULL)
-                                            {
-                                                char *type = json_value_to_string(value);
-
-                                                if (!strcmp(type, "LOW"))
-                                                {
-                                                    fcrt_settings.vc_regular_array[i].type = VC_TYPE_LOW;
-                                                }
-                                                else if (!strcmp(type, "HIGH"))
-                                                {
-                                                    fcrt_settings.vc_regular_array[i].type = VC_TYPE_HIGH;
-                                                }
-                                                else
-                                                {
-                                                    fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                    continue;
-                                                }
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Проверка DST_ID
-                                            value = json_value_with_key(regular_vc, "dst_id");
-
-                                            if (value != NULL)
-                                            {
-                                                fcrt_settings.vc_regular_array[i].dst_id = (uint32_t)json_value_to_double(value);
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
+        if (result == SUCCESS)
+            result = fc_settings_from_tape(&tape, &settings);
 
-#ifdef GREK_FCRT
-                                            // Проверка выходного порта
-                                            value = json_value_with_key(regular_vc, "period");
-
-                                            if (value != NULL)
-                                            {
-                                                fcrt_settings.vc_regular_array[i].period = (uint32_t)json_value_to_double(value);
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-#else
+        bench_sample(counters, &converted);
 
-                                            // Проверка SRC_ID
-                                            value = json_value_with_key(regular_vc, "src_id");
-
-                                            if (value != NULL)
-                                            {
-                                                fcrt_settings.vc_regular_array[i].src_id = (uint32_t)json_value_to_double(value);
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Проверка входного порта
-                                            value = json_value_with_key(regular_vc, "input_port");
-
-                                            if (value != NULL)
-                                            {
-                                                fcrt_settings.vc_regular_array[i].input_port = (uint32_t)json_value_to_double(value);
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Проверка выходного порта
-                                            value = json_value_with_key(regular_vc, "output_port");
-
-                                            if (value != NULL)
-                                            {
-                                                fcrt_settings.vc_regular_array[i].output_port = (uint32_t)json_value_to_double(value);
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-#endif
-                                            // Проверка выходного порта
-                                            value = json_value_with_key(regular_vc, "priority");
-
-                                            if (value != NULL)
-                                            {
-                                                fcrt_settings.vc_regular_array[i].priority = (uint32_t)json_value_to_double(value);
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Проверка выходного порта
-                                            value = json_value_with_key(regular_vc, "input_asm_id");
-
-                                            if (value != NULL)
-                                            {
-                                                fcrt_settings.vc_regular_array[i].input_asm_id = (uint32_t)json_value_to_double(value);
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Проверка выходного порта
-                                            value = json_value_with_key(regular_vc, "output_asm_id");
-
-                                            if (value != NULL)
-                                            {
-                                                fcrt_settings.vc_regular_array[i].output_asm_id = (uint32_t)json_value_to_double(value);
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Проверка выходного порта
-                                            value = json_value_with_key(regular_vc, "max_size");
-
-                                            if (value != NULL)
-                                            {
-                                                fcrt_settings.vc_regular_array[i].max_size = (uint32_t)json_value_to_double(value);
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Проверка выходного порта
-                                            value = json_value_with_key(regular_vc, "input_queue");
-
-                                            if (value != NULL)
-                                            {
-                                                fcrt_settings.vc_regular_array[i].input_queue = (uint32_t)json_value_to_double(value);
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Проверка выходного порта
-                                            value = json_value_with_key(regular_vc, "output_queue");
-
-                                            if (value != NULL)
-                                            {
-                                                fcrt_settings.vc_regular_array[i].output_queue = (uint32_t)json_value_to_double(value);
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Проверка выходного порта
-                                            value = json_value_with_key(regular_vc, "duplication");
-
-                                            if (value != NULL)
-                                            {
-                                                char *duplication = json_value_to_string(value);
-
-                                                if (!strcmp(duplication, "A"))
-                                                {
-                                                    fcrt_settings.vc_regular_array[i].duplication = VC_DUPLICATION_A;
-                                                }
-                                                else if (!strcmp(duplication, "B"))
-                                                {
-                                                    fcrt_settings.vc_regular_array[i].duplication = VC_DUPLICATION_B;
-                                                }
-                                                else if (!strcmp(duplication, "AB"))
-                                                {
-                                                    fcrt_settings.vc_regular_array[i].duplication = VC_DUPLICATION_AB;
-                                                }
-                                                else
-                                                {
-                                                    fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                    continue;
-                                                }
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-
-                                            // Проверка выходного порта
-                                            value = json_value_with_key(regular_vc, "channel_type");
-
-                                            if (value != NULL)
-                                            {
-                                                char *channel_type = json_value_to_string(value);
-
-                                                if (!strcmp(channel_type, "FCRT"))
-                                                {
-                                                    fcrt_settings.vc_regular_array[i].channel_type = VC_FCRT;
-                                                }
-                                                else if (!strcmp(channel_type, "ASM"))
-                                                {
-                                                    fcrt_settings.vc_regular_array[i].channel_type = VC_ASM;
-
-                                                    // Проверка, что дублирование AB отключено
-                                                    if (fcrt_settings.vc_regular_array[i].duplication == VC_DUPLICATION_AB)
-                                                    {
-                                                        fcrt_settings.vc_regular_array[i].duplication = VC_DUPLICATION_A;
-                                                    }
-                                                }
-                                                else
-                                                {
-                                                    fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                    continue;
-                                                }
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-#ifndef GREK_FCRT
-                                            // Проверка выходного порта
-                                            value = json_value_with_key(regular_vc, "timeout_AB");
-
-                                            if (value != NULL)
-                                            {
-                                                fcrt_settings.vc_regular_array[i].timeout_AB = (uint32_t)json_value_to_double(value);
-                                            }
-                                            else
-                                            {
-                                                fcrt_settings.vc_regular_array[i].enabled = VC_OFF;
-                                                continue;
-                                            }
-#endif
+        if (result == SUCCESS)
+            fc_settings_free(&settings);
 
-                                            // Увеличение счетчика корректных ВК регклярного сообщения
-                                            fcrt_settings.regular_enabled_count++;
-#endif
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                        else
-                        {
+        json_tape_free(&tape);
+        json_input_close(&input);
 
-                        }
+        if (result != SUCCESS)
+            return DEF_ERROR;
 
-                        // Флаг успеха получения конфигурации
-                        uint8_t periodical_success_parse = 0;
+        bench_record(counters, &best[BENCH_TAPE_PARSE], &begin, &end);
+        bench_record(counters, &best[BENCH_TAPE_CONVERT], &end, &converted);
 
-                        // По умолчанию канал отключен
-#ifdef ETHERNET_MODE
+        // Запись дерева обратно в JSON
+        if (json_input_open(json_path, &input) != SUCCESS)
+            return DEF_ERROR;
 
-#else
-                        fcrt_settings.periodical_state = VC_OFF;
-#endif
+        json_arena_init(&arena, input.size);
+        result = (json_parse_arena(input.data, &root, &arena, JSON_PARSE_IN_SITU) == 1) ? SUCCESS : DEF_ERROR;
 
-                        // Поиск узла PERIODICAL_CONFIG
-                        json_value *periodical_root = json_value_with_key(&root, "PERIODICAL_CONFIG");
+        bench_sample(counters, &begin);
+        char *text = (result == SUCCESS) ? json_serialize(&root, 0, NULL) : NULL;
+        bench_sample(counters, &end);
 
-                        if (periodical_root != NULL)
-                        {
-                            if (periodical_root->value.array.size == 1)
-                            {
-                                json_value *periodical_vc = json_value_at(periodical_root, 0);
+        result = (text != NULL) ? SUCCESS : DEF_ERROR;
+        free(text);
+        json_arena_release(&arena);
+        json_input_close(&input);
 
-                                if (periodical_vc != NULL)
-                                {
-#ifdef ETHERNET_MODE
-                                    // Проверка включения ВК
-                                    json_value *value = json_value_with_key(periodical_vc, "active");
+        if (result != SUCCESS)
+            return DEF_ERROR;
+
+        bench_record(counters, &best[BENCH_SERIALIZE], &begin, &end);
+    }
+
+    return SUCCESS;
+}
+
+
+char help_str[] = {
+    "Using:\n\tjson_bench [-r repeats] [-d directory] [entries ...]\n"
+    "\tentries - number of REGULAR_CONFIG entries, 1..1000000 (default 1 100 10000 100000)\n"
+    "Output: CSV lines entries,bytes,phase,seconds,mb_per_s,entries_per_s,cycles,instructions,branch_misses,\n"
+    "\tl1d_misses,llc_misses,ipc,cycles_per_byte (counter fields are empty when perf_event_open is unavailable)\n"
+};
+
+int main(int argc, char * argv[])
+{
+    static const size_t default_entries[] = { 1, 100, 10000, 100000 };
+    const char *directory = "/tmp";
+    int repeats = BENCH_REPEATS;
+    size_t entries[64];
+    size_t count = 0;
+    bench_counters_t counters;
+    size_t n = 0;
+    int i = 0;
+
+    for (i = 1; i < argc; i++)
+    {
+        char *end = NULL;
+
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+        {
+            repeats = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+        {
+            directory = argv[++i];
+        }
+        else
+        {
+            unsigned long value = strtoul(argv[i], &end, 10);
 
-                                    if (value != NULL)
-                                    {
-                                        char *active = json_value_to_string(value);
+            if (*end != '\0' || value < 1 || value > BENCH_MAX_ENTRIES || count == sizeof(entries) / sizeof(entries[0]))
+            {
+                printf("%s", help_str);
+                return -EINVAL;
+            }
 
-                                        if (!strcmp(active, "ON"))
-                                        {
-                                            ethernet_settings.vc_periodical_array.enabled = VC_ON;
+            entries[count++] = value;
+        }
+    }
 
-                                            // Проверка включения ВК
-                                            value = json_value_with_key(periodical_vc, "server_ip");
+    if (repeats < 1)
+    {
+        printf("%s", help_str);
+        return -EINVAL;
+    }
 
-                                            if (value != NULL)
-                                            {
-                                                char *client_ip = json_value_to_string(value);
+    if (count == 0)
+    {
+        count = sizeof(default_entries) / sizeof(default_entries[0]);
+        memcpy(entries, default_entries, sizeof(default_entries));
+    }
 
-                                                memset(ethernet_settings.vc_periodical_array.server_ip, 0, 16);
-                                                strcpy(ethernet_settings.vc_periodical_array.server_ip, client_ip);
+    // Без аппаратных счетчиков (виртуальная машина, perf_event_paranoid) замеряется только время
+    if (bench_counters_open(&counters) != SUCCESS)
+        fprintf(stderr, "json_bench: hardware counters unavailable (%s), reporting time only\n", strerror(errno));
 
-                                                // Проверка включения ВК
-                                                value = json_value_with_key(periodical_vc, "client_ip");
+    printf("entries,bytes,phase,seconds,mb_per_s,entries_per_s");
 
-                                                if (value != NULL)
-                                                {
-                                                    char *client_ip = json_value_to_string(value);
+    for (i = 0; i < BENCH_COUNTERS; i++)
+        printf(",%s", bench_counter_names[i]);
 
-                                                    memset(ethernet_settings.vc_periodical_array.client_ip, 0, 16);
-                                                    strcpy(ethernet_settings.vc_periodical_array.client_ip, client_ip);
+    printf(",ipc,cycles_per_byte\n");
 
-                                                    value = json_value_with_key(periodical_vc, "client_rcv_port");
+    for (n = 0; n < count; n++)
+    {
+        char json_path[4096];
+        char cfg_path[4096];
+        bench_result_t best[BENCH_PHASES];
 
-                                                    if (value != NULL)
-                                                    {
-                                                        ethernet_settings.vc_periodical_array.client_rcv_port = (uint32_t) json_value_to_double(
-                                                                value);
+        snprintf(json_path, sizeof(json_path), "%s/json_bench_%d_%zu.json", directory, (int)getpid(), entries[n]);
+        snprintf(cfg_path, sizeof(cfg_path), "%s/json_bench_%d_%zu.cfg", directory, (int)getpid(), entries[n]);
 
-                                                        value = json_value_with_key(periodical_vc, "server_snd_port");
+        size_t bytes = bench_generate(json_path, entries[n]);
+        int result = (bytes > 0) ? bench_run(json_path, cfg_path, repeats, &counters, best) : DEF_ERROR;
 
-                                                        if (value != NULL)
-                                                        {
-                                                            ethernet_settings.vc_periodical_array.server_snd_port = (uint32_t) json_value_to_double(
-                                                                    value);
+        unlink(json_path);
+        unlink(cfg_path);
 
-                                                            value = json_value_with_key(periodical_vc, "period");
+        if (result != SUCCESS)
+        {
+            fprintf(stderr, "json_bench: %zu entries failed\n", entries[n]);
+            bench_counters_close(&counters);
+            return -EIO;
+        }
 
-                                                            if (value != NULL)
-                                                            {
-                                                                ethernet_settings.vc_periodical_array.period = (uint32_t) json_value_to_double(
-                                                                        value);
+        for (i = 0; i < BENCH_PHASES; i++)
+        {
+            const bench_result_t *phase = &best[i];
+            double seconds = (phase->seconds > 0) ? phase->seconds : 1e-9;
+            int k = 0;
 
-                                                                value = json_value_with_key(periodical_vc, "max_size");
+            printf("%zu,%zu,%s,%.9f,%.3f,%.1f", entries[n], bytes, bench_phase_names[i], phase->seconds,
+                   (double)bytes / seconds / 1e6, (double)entries[n] / seconds);
 
-                                                                if (value != NULL)
-                                                                {
-                                                                    ethernet_settings.vc_periodical_array.max_size = (uint32_t) json_value_to_double(
-                                                                            value);
+            for (k = 0; k < BENCH_COUNTERS; k++)
+            {
+                if (phase->values[k] >= 0)
+                    printf(",%.0f", phase->values[k]);
+                else
+                    printf(",");
+            }
 
-                                                                    periodical_success_parse = 1;
-                                                                }
-                                                            }
-                                                        }
-                                                    }
-                                                }
-                                            }
-                                        }
-                                    }
+            double cycles = phase->values[BENCH_CYCLES];
+            double instructions = phase->values[BENCH_INSTRUCTIONS];
 
-#else
-                                    // Проверка включения ВК
-                                    json_value *value = json_value_with_key(periodical_vc, "active");
+            if (cycles > 0 && instructions >= 0)
+                printf(",%.3f", instructions / cycles);
+            else
+                printf(",");
 
-                                    if (value != NULL)
-                                    {
-                                        char *active = json_value_to_string(value);
+            if (cycles >= 0)
+                printf(",%.3f\n", cycles / (double)bytes);
+            else
+                printf(",\n");
+        }
 
-                                        if (!strcmp(active, "ON"))
-                                        {
-                                            fcrt_settings.periodical_state = VC_ON;
-#ifndef GREK_FCRT
-                                            //копируем комментарий
-                                            value = json_value_with_key(periodical_vc, "comment");
-                                            if (value != NULL)
-                                            {
-                                                char *comment = json_value_to_string(value);
-                                                snprintf(fcrt_settings.vc_periodical_array.comment, sizeof(fcrt_settings.vc_periodical_array.comment), "\n# %s\n", comment);
-                                            }
-                                            // Проверка DST_ID
-                                            value = json_value_with_key(periodical_vc, "dst_id");
-
-                                            if (value != NULL)
-                                            {
-                                                fcrt_settings.vc_periodical_array.dst_id = (uint32_t) json_value_to_double(
-                                                        value);
-
-                                                // Проверка SRC_ID
-                                                value = json_value_with_key(periodical_vc, "src_id");
-
-                                                if (value != NULL)
-                                                {
-                                                    fcrt_settings.vc_periodical_array.src_id = (uint32_t) json_value_to_double(
-                                                            value);
-#endif
+        fflush(stdout);
+    }
 
-                                                    value = json_value_with_key(periodical_vc, "output_port");
-
-                                                    if (value != NULL)
-                                                    {
-                                                        fcrt_settings.vc_periodical_array.output_port = (uint32_t) json_value_to_double(
-                                                                value);
-
-                                                        value = json_value_with_key(periodical_vc, "period");
-
-                                                        if (value != NULL)
-                                                        {
-                                                            fcrt_settings.vc_periodical_array.period = (uint32_t) json_value_to_double(
-                                                                    value);
-
-                                                            value = json_value_with_key(periodical_vc, "output_asm_id");
-
-                                                            if (value != NULL)
-                                                            {
-                                                                fcrt_settings.vc_periodical_array.output_asm_id = (uint32_t) json_value_to_double(
-                                                                        value);
-
-                                                                value = json_value_with_key(periodical_vc, "max_size");
-
-                                                                if (value != NULL)
-                                                                {
-                                                                    fcrt_settings.vc_periodical_array.max_size = (uint32_t) json_value_to_double(
-                                                                            value);
-
-                                                                    // Проверка выходного порта
-                                                                    value = json_value_with_key(periodical_vc,
-                                                                                                "duplication");
-
-                                                                    if (value != NULL)
-                                                                    {
-                                                                        char *duplication = json_value_to_string(value);
-
-                                                                        if (!strcmp(duplication, "A"))
-                                                                        {
-                                                                            fcrt_settings.vc_periodical_array.duplication = VC_DUPLICATION_A;
-                                                                            periodical_success_parse = 1;
-                                                                        }
-                                                                        else if (!strcmp(duplication, "B"))
-                                                                        {
-                                                                            fcrt_settings.vc_periodical_array.duplication = VC_DUPLICATION_B;
-                                                                            periodical_success_parse = 1;
-                                                                        }
-                                                                        else if (!strcmp(duplication, "AB"))
-                                                                        {
-                                                                            fcrt_settings.vc_periodical_array.duplication = VC_DUPLICATION_AB;
-                                                                            periodical_success_parse = 1;
-                                                                        }
-                                                                        else
-                                                                        {
-                                                                            fcrt_settings.periodical_state = VC_OFF;
-                                                                        }
+    bench_counters_close(&counters);
 
-#ifdef GREK_FCRT
-                                                                        if (fcrt_settings.periodical_state == VC_ON)
-                                                                        {
-                                                                            // Проверка выходного порта
-                                                                            value = json_value_with_key(periodical_vc,
-                                                                                                        "channel_type");
-
-                                                                            if (value != NULL)
-                                                                            {
-                                                                                char *channel_type = json_value_to_string(
-                                                                                        value);
-
-                                                                                if (!strcmp(channel_type, "FCRT"))
-                                                                                {
-                                                                                    fcrt_settings.vc_periodical_array.channel_type = VC_FCRT;
-                                                                                    periodical_success_parse = 1;
-                                                                                }
-                                                                                else if (!strcmp(channel_type, "ASM"))
-                                                                                {
-                                                                                    fcrt_settings.vc_periodical_array.channel_type = VC_ASM;
-
-                                                                                    // Проверка, что дублирование AB отключено
-                                                                                    if (fcrt_settings.vc_periodical_array.duplication == VC_DUPLICATION_AB)
-                                                                                    {
-                                                                                        fcrt_settings.vc_periodical_array.duplication = VC_DUPLICATION_A;
-                                                                                    }
-
-                                                                                    periodical_success_parse = 1;
-                                                                                }
-                                                                                else
-                                                                                {
-                                                                                    fcrt_settings.periodical_state = VC_OFF;
-                                                                                }
-                                                                            }
-                                                                            else
-                                                                            {
-                                                                                fcrt_settings.periodical_state = VC_OFF;
-                                                                            }
-                                                                        }
+    return 0;
+}
 #else
-                                                                        if (fcrt_settings.periodical_state == VC_ON)
-                                                                        {
-                                                                            value = json_value_with_key(periodical_vc, "priority");
-
-                                                                            if (value != NULL)
-                                                                            {
-                                                                                fcrt_settings.vc_periodical_array.priority = (uint32_t) json_value_to_double(
-                                                                                        value);
-
-                                                                                periodical_success_parse = 1;
-                                                                            }
-                                                                            else
-                                                                            {
-                                                                                periodical_success_parse = 0;
-                                                                            }
-                                                                        }
-#endif
-                                                                    }
-                                                                }
-                                                            }
-                                                        }
-                                                    }
+char help_str[] = {
+    "Using:\n\tjson_parser [-j threads] <path to json file> <path to converted cfg file>\n"
+    "\tjson_parser - <path to converted cfg file>\t(read json from stdin)\n"
+    "\tjson_parser [-j threads] -b <manifest>\t(convert \"<json> <cfg>\" pairs, one per line)\n"
+    "\tjson_parser -w <path to json file> <path to converted cfg file>\t(reconvert on every change, single thread)\n"
+    "\t-c <directory>\treuse cfg results cached by input hash\n"
+#ifndef ETHERNET_MODE
 #ifndef GREK_FCRT
-                                                }
-                                            }
+    "\t-i <path to image file>\talso write the binary settings image and check it against the cfg\n"
 #endif
-                                        }
-                                    }
 #endif
-                                }
-                            }
-                        }
-
-                        if (periodical_success_parse == 0)
-                        {
-#ifdef ETHERNET_MODE
-                            ethernet_settings.periodical_state = VC_OFF;
-#else
-                            fcrt_settings.periodical_state = VC_OFF;
+    "\tjson_parser -q <json pointer> <path to json file>\t(print one value, e.g. -q /REGULAR_CONFIG/17/dst_id)\n"
+#ifdef JSON_STATS
+    "\t--stats\tprint per-phase timings, node counts and memory usage as JSON to stderr\n"
 #endif
-                        }
+};
 
-#ifndef ETHERNET_MODE
-#ifndef GREK_FCRT
-                        // Значения по умолчанию
-                        fcrt_settings.deep_filter = 0;
-                        fcrt_settings.reset_pause = 0;
-
-                        // Поиск узла REGULAR_CONFIG
-                        json_value *config_root = json_value_with_key(&root, "COMMON_CONFIG");
-
-                        if (config_root != NULL)
-                        {
-                            if (config_root->value.array.size > 0)
-                            {
-                                // Парсинг файла конфигурации и заполнение структур
-                                size_t i = 0;
-
-                                for (i = 0; i < config_root->value.array.size; i++)
-                                {
-                                    json_value *common_config = json_value_at(config_root, i);
-
-                                    if (common_config != NULL)
-                                    {
-                                        json_value *value = json_value_with_key(common_config, "name");
-
-                                        if (value != NULL)
-                                        {
-                                            char *name = json_value_to_string(value);
-
-                                            if (!strcmp(name, "pause"))
-                                            {
-                                                value = json_value_with_key(common_config, "value");
-
-                                                if (value != NULL)
-                                                {
-                                                    fcrt_settings.reset_pause = (uint32_t) json_value_to_double(
-                                                            value);
-                                                }
-                                            }
-                                            else if (!strcmp(name, "fc_rx_err_delay"))
-                                            {
-                                                value = json_value_with_key(common_config, "value");
-
-                                                if (value != NULL)
-                                                {
-                                                    fcrt_settings.deep_filter = (uint32_t) json_value_to_double(
-                                                            value);
-                                                }
-                                            }
-                                        }
-                                    }
-                                }
-                            }
-                        }
-#endif
+int main(int argc, char * argv[])
+{
+    char * json_cnf_path;
+    char * cfg_cnf_path;
+    char * manifest_path = NULL;
+    char * image_path = NULL;
+    char * query = NULL;
+    fc_cache_t cache = { NULL, 0, 0 };
+    int threads = 1;
+    int watch = 0;
+    int arg = 1;
+
+    while(argc - arg >= 2 && argv[arg][0] == '-' && argv[arg][1] != '\0')
+    {
+        if(strcmp(argv[arg], "-w") == 0)
+        {
+            watch = 1;
+            arg += 1;
+            continue;
+        }
+#ifdef JSON_STATS
+        else if(strcmp(argv[arg], "--stats") == 0)
+        {
+            json_stats.enabled = 1;
+            arg += 1;
+            continue;
+        }
 #endif
-                    }
-                    else
-                    {
-                        printf("parse error\n");
-                        error_counter++;
-                    }
-
-                    json_free_value(&root);
-                }
-                else
-                {
-                    printf("read file error\n");
-                    error_counter++;
-                }
+        else if(strcmp(argv[arg], "-j") == 0)
+        {
+            char *end = NULL;
+            long value = strtol(argv[arg + 1], &end, 10);
 
-                free(file_buffer);
-            }
-            else
+            if(*end != '\0' || value < 1 || value > FC_PARALLEL_MAX_THREADS)
             {
-                printf("malloc error\n");
-                error_counter++;
+                printf("%s", help_str);
+                return -EINVAL;
             }
 
-            close(json_fd);
+            threads = (int)value;
+        }
+        else if(strcmp(argv[arg], "-b") == 0)
+        {
+            manifest_path = argv[arg + 1];
+        }
+        else if(strcmp(argv[arg], "-c") == 0)
+        {
+            cache.dir = argv[arg + 1];
+        }
+#ifndef ETHERNET_MODE
+#ifndef GREK_FCRT
+        else if(strcmp(argv[arg], "-i") == 0)
+        {
+            image_path = argv[arg + 1];
+        }
+#endif
+#endif
+        else if(strcmp(argv[arg], "-q") == 0)
+        {
+            query = argv[arg + 1];
         }
         else
         {
-            printf("empty file error\n");
-            error_counter++;
+            printf("%s", help_str);
+            return -EINVAL;
         }
+
+        arg += 2;
     }
 
-    if (error_counter > 0)
+    if(query != NULL)
     {
-        return DEF_ERROR;
+        if(argc - arg != 1 || manifest_path != NULL || watch || image_path != NULL || JSON_STATS_ENABLED)
+        {
+            printf("%s", help_str);
+            return -EINVAL;
+        }
+
+        return (process_json_query(argv[arg], query) == SUCCESS) ? 0 : -EINVAL;
     }
-    ///пишем данные в файл cfg
-    int cfg_fd = open(dest_path, O_CREAT | O_TRUNC | O_RDWR, S_IRWXU | S_IRWXG | S_IRWXO);
-    if(cfg_fd > 0)
-    {
-        int i;
-        #define BUFSZ 256
-        char buf[BUFSZ];
-        vc_regular_data_t * rd = NULL;
-        vc_periodical_data_t * pd = NULL;
-        rd = fcrt_settings.vc_regular_array;
-        pd = &fcrt_settings.vc_periodical_array;
-        ///обычные сообщения
-        for(i = 0; i < fcrt_settings.regular_overall_count; i++, rd++)
-        {
-            snprintf(buf, BUFSZ, "%c=%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n",
-            rd->type,
-            rd->dst_id, rd->src_id,
-            rd->input_port, rd->output_port,
-            rd->priority,
-            rd->input_asm_id,rd->output_asm_id,
-            rd->max_size,
-            rd->input_queue, rd->output_queue,
-            rd->duplication,
-            rd->channel_type,
-            rd->timeout_AB
-            );
-#if 0
-            printf("%s", buf);
-#endif
-            write(cfg_fd, rd->comment, strlen(rd->comment));
-            if(rd->enabled == VC_OFF)
-                write(cfg_fd, "#", strlen("#"));
 
-            write(cfg_fd, buf, strlen(buf));
+    if(manifest_path != NULL)
+    {
+        if(arg != argc || watch || image_path != NULL || JSON_STATS_ENABLED)
+        {
+            printf("%s", help_str);
+            return -EINVAL;
         }
-        ///статусное сообщение
-        snprintf(buf, BUFSZ, "P=%u,%u,%u,%u,%u,%u,%u,%u\n",
-        pd->dst_id, pd->src_id,
-        pd->output_port,
-        pd->period,
-        pd->output_asm_id,
-        pd->max_size,
-        pd->duplication,
-        pd->priority
-        );
 
-#if 0
-        printf("%s", buf);
-#endif
-        write(cfg_fd, pd->comment, strlen(pd->comment));
-        write(cfg_fd, buf, strlen(buf));
-        close(cfg_fd);
+        return (process_json_fcrt_settings_batch(manifest_path, threads, cache.dir ? &cache : NULL) == SUCCESS) ? 0 : -EINVAL;
     }
-    else
-        printf("\nError: could not open file\n");
-    free(fcrt_settings.vc_regular_array);
-    
-    return SUCCESS;
-}
 
-char help_str[] = {
-    "Using:\n\tjson_parser <path to json file> <path to converted cfg file>\n"
-};
+    if(argc - arg != 2)
+    {
+        printf("%s", help_str);
+        return -EINVAL;
+    }
+    json_cnf_path = argv[arg];
+    cfg_cnf_path = argv[arg + 1];
 
-int main(int argc, char * argv[])
-{
-    char * json_cnf_path;
-    char * cfg_cnf_path;
-    if(argc != 3)
+    // Резидентный режим преобразует файл в одном потоке с сохраняемыми буферами
+    if(watch && (image_path != NULL || JSON_STATS_ENABLED || threads > 1))
     {
         printf("%s", help_str);
         return -EINVAL;
     }
-    json_cnf_path = argv[1];
-    cfg_cnf_path = argv[2];
 
-    if(process_json_fcrt_settings_file(json_cnf_path, cfg_cnf_path) != SUCCESS)
+    if(watch)
+        return (process_json_fcrt_settings_watch(json_cnf_path, cfg_cnf_path, cache.dir ? &cache : NULL) == SUCCESS) ? 0 : -EINVAL;
+
+    int result = process_json_fcrt_settings_file(json_cnf_path, cfg_cnf_path, image_path, threads, cache.dir ? &cache : NULL);
+
+#ifdef JSON_STATS
+    // Статистика выводится в stderr, чтобы не смешиваться с сообщениями преобразования
+    if(json_stats.enabled)
+        json_stats_report(json_cnf_path, STDERR_FILENO);
+#endif
+
+    if(result != SUCCESS)
     {
         printf("\n---- Error. Could not convert json config file %s to %s file", json_cnf_path, cfg_cnf_path);
         return -EINVAL;
     }
     return 0;
-}
\ No newline at end of file
+}
+#endif